@@ -0,0 +1,120 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "csvparse.hpp"
+
+
+// Apache Arrow C Data Interface.
+// Results are exported as a struct array, one child per column with time
+// first, in Arrow's columnar layout: float64 for time and float columns, int32,
+// bit-packed bool and utf8 strings. Cells that do not hold their column's type
+// are exported as nulls. The columnar buffers of a result are built once and
+// shared by every array exported from it; they are freed when the last
+// consumer releases its array. Imports read record batches in the same
+// interface without copying them first.
+// The structs are the ABI from the specification, no Arrow library is needed.
+
+
+#ifndef ARROW_C_DATA_INTERFACE
+#define ARROW_C_DATA_INTERFACE
+
+#define ARROW_FLAG_DICTIONARY_ORDERED 1
+#define ARROW_FLAG_NULLABLE 2
+#define ARROW_FLAG_MAP_KEYS_SORTED 4
+
+struct ArrowSchema {
+    // Array type description
+    const char* format;
+    const char* name;
+    const char* metadata;
+    int64_t flags;
+    int64_t n_children;
+    struct ArrowSchema** children;
+    struct ArrowSchema* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowSchema*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+struct ArrowArray {
+    // Array data description
+    int64_t length;
+    int64_t null_count;
+    int64_t offset;
+    int64_t n_buffers;
+    int64_t n_children;
+    const void** buffers;
+    struct ArrowArray** children;
+    struct ArrowArray* dictionary;
+
+    // Release callback
+    void (*release)(struct ArrowArray*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+#endif  // ARROW_C_DATA_INTERFACE
+
+
+#ifndef ARROW_C_STREAM_INTERFACE
+#define ARROW_C_STREAM_INTERFACE
+
+struct ArrowArrayStream {
+    // Callbacks providing stream functionality
+    int (*get_schema)(struct ArrowArrayStream*, struct ArrowSchema* out);
+    int (*get_next)(struct ArrowArrayStream*, struct ArrowArray* out);
+    const char* (*get_last_error)(struct ArrowArrayStream*);
+
+    // Release callback
+    void (*release)(struct ArrowArrayStream*);
+    // Opaque producer-specific data
+    void* private_data;
+};
+
+#endif  // ARROW_C_STREAM_INTERFACE
+
+
+// One column in Arrow layout.
+struct ArrowColumn {
+    std::string name;
+    ColumnType type = ColumnType::Double;
+    bool nullable = true;            // False for the time column
+    int64_t nullCount = 0;
+    std::vector<uint8_t> validity;   // One bit per row, empty without nulls
+    std::vector<uint8_t> values;     // Fixed-width values, one bit per row for Bool
+    std::vector<int32_t> offsets;    // String only, length + 1 entries
+    std::string chars;               // String only, the concatenated values
+};
+
+
+// A result in Arrow layout, exported as one record batch.
+struct ArrowBatch {
+    int64_t length = 0;
+    std::vector<ArrowColumn> columns;
+};
+
+
+// Builds the columns of `data`, one column per task. Column types come from
+// `data.types`, or from the first row when the result has no schema.
+ArrowBatch makeArrowBatch(const CSVData& data, int threads = 0);
+
+// Exports fill a released (or uninitialized) struct the caller then owns and
+// must release. Arrays and streams keep `batch` alive until released.
+void exportArrowSchema(const ArrowBatch& batch, ArrowSchema* out);
+void exportArrowArray(const std::shared_ptr<const ArrowBatch>& batch, ArrowArray* out);
+void exportArrowStream(const std::shared_ptr<const ArrowBatch>& batch, ArrowArrayStream* out);
+
+// Converts a record batch (a struct array) into points. Children are matched
+// to `headers` by name, the first header being the time column, which may be
+// numeric or a timestamp. Values are converted to `types`, inferred from the
+// Arrow types if empty. Null floats become NaN. Throws std::invalid_argument
+// for missing or extra columns, unsupported or mismatched types and other nulls.
+std::vector<Point> importArrowArray(const ArrowSchema& schema, const ArrowArray& array,
+                                    const std::vector<std::string>& headers,
+                                    const std::vector<ColumnType>& types);
@@ -0,0 +1,227 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "csvparse.hpp"
+
+
+// Change feed: appended, updated and deleted points pushed to subscribers.
+// The write path publishes every change under the database lock and, right
+// after releasing it, the writer delivers the published events into a bounded
+// single-producer single-consumer queue per subscriber. The subscriber drains
+// its queue without taking the database lock, so a change is visible
+// microseconds after it was applied rather than after the next checkpoint.
+// Events are delivered in sequence order as writes are applied; compare `seq`
+// with the committed sequence number to tell whether a change is on disk yet.
+//
+// A full queue pushes back on the writer (Block), which waits for the
+// subscriber to catch up, or disconnects the subscriber (Disconnect). The wait
+// holds no database lock, so subscribers and other threads can keep reading;
+// deliveries are serialized, so other writers wait for it once they have
+// applied their change. A subscriber that blocks longer than its timeout is
+// disconnected as well and marked lagged. Recent events can be retained, so a
+// subscriber can start, or resume after lagging, from an earlier sequence
+// number.
+
+
+enum class ChangeKind {
+    Append,
+    Update,  // Carries the new point; uses the sequence numbers of its delete and insert halves
+    Delete   // Carries the deleted point
+};
+
+
+struct ChangeEvent {
+    uint64_t seq = 0;
+    ChangeKind kind = ChangeKind::Append;
+    Point point;
+};
+
+
+// Subscribes from the sequence number current at the time of subscribing.
+constexpr uint64_t LIVE_CHANGES = std::numeric_limits<uint64_t>::max();
+
+
+enum class Backpressure {
+    Block,      // The writer waits for space, up to the subscription's timeout
+    Disconnect  // The subscription is closed as lagged
+};
+
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Each side owns one index; a slot is written before the producer publishes
+// it with a release store and read after the consumer acquires it.
+template <typename T>
+class SpscQueue {
+public:
+    explicit SpscQueue(size_t capacity) : slots(roundUp(capacity)), mask(slots.size() - 1) {}
+
+    size_t capacity() const { return slots.size(); }
+
+    size_t size() const {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    bool tryPush(T value) {
+        uint64_t current = head.load(std::memory_order_relaxed);
+        if (current - tail.load(std::memory_order_acquire) == slots.size()) {
+            return false;
+        }
+        slots[current & mask] = std::move(value);
+        head.store(current + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool tryPop(T& out) {
+        uint64_t current = tail.load(std::memory_order_relaxed);
+        if (current == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        out = std::move(slots[current & mask]);
+        tail.store(current + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static size_t roundUp(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        return size;
+    }
+
+    std::vector<T> slots;
+    size_t mask;
+    alignas(64) std::atomic<uint64_t> head{0};  // Next slot to write, producer only
+    alignas(64) std::atomic<uint64_t> tail{0};  // Next slot to read, consumer only
+};
+
+
+class ChangeFeed;
+
+
+// One subscriber's queue. Owned jointly by the feed and the subscriber.
+class ChangeSubscription {
+public:
+    // `blockTimeoutMs` < 0 blocks the writer until there is space.
+    ChangeSubscription(size_t capacity, Backpressure backpressure, int blockTimeoutMs);
+
+    ChangeSubscription(const ChangeSubscription&) = delete;
+    ChangeSubscription& operator=(const ChangeSubscription&) = delete;
+
+    // Consumer side, one thread at a time. Moves up to `maxEvents` events into
+    // `out`, waiting up to `timeoutMs` for the first one (< 0 waits until an
+    // event arrives or the subscription is closed). Returns the number moved,
+    // 0 on timeout or once closed and drained.
+    size_t poll(std::vector<ChangeEvent>& out, size_t maxEvents, int timeoutMs);
+
+    // Stops delivery; events already queued can still be polled.
+    void close();
+
+    bool closed() const { return isClosed.load(); }
+    bool lagged() const { return isLagged.load(); }
+    size_t pending() const { return queue.size(); }
+    // Sequence number of the last event polled, to resume from after lagging.
+    uint64_t lastPolled() const { return polledSeq.load(); }
+
+private:
+    friend class ChangeFeed;
+
+    // Producer side, serialized by ChangeFeed::deliver. Applies the
+    // backpressure policy and returns false once the subscription is closed.
+    bool offer(const ChangeEvent& event);
+    void disconnect();
+
+    SpscQueue<ChangeEvent> queue;
+    Backpressure backpressure;
+    int blockTimeoutMs;
+    std::atomic<bool> isClosed{false};
+    std::atomic<bool> isLagged{false};
+    std::atomic<uint64_t> polledSeq{0};
+    uint64_t queuedSeq = 0;  // Last sequence number queued, older pending events are skipped
+
+    // Sleeping only: a side sets its flag before waiting, the other notifies
+    // if it sees the flag after its own queue operation.
+    std::mutex wakeMutex;
+    std::condition_variable consumerWake;
+    std::condition_variable producerWake;
+    std::atomic<bool> consumerWaiting{false};
+    std::atomic<bool> producerWaiting{false};
+};
+
+
+// Subscribers and retained events of one database. Everything but deliver()
+// is used under the database lock.
+class ChangeFeed {
+public:
+    ~ChangeFeed();
+
+    // Keeps the last `events` events for subscriptions starting in the past.
+    // `lastSeq` is the current sequence number, retention starts after it.
+    void setRetention(size_t events, uint64_t lastSeq);
+    size_t retention() const { return retainCapacity; }
+
+    // True if published events go anywhere; the write path skips building them otherwise.
+    bool active() const { return retainCapacity > 0 || subscriberCount.load() > 0; }
+
+    // New subscription receiving every event after `fromSeq`, or after
+    // `lastSeq` for LIVE_CHANGES. Retained events
+    // are queued first, the queue grows to hold them. Throws
+    // std::invalid_argument if events after `fromSeq` are no longer retained.
+    std::shared_ptr<ChangeSubscription> subscribe(uint64_t fromSeq, uint64_t lastSeq, size_t capacity,
+                                                  Backpressure backpressure, int blockTimeoutMs);
+
+    // Retains the event and queues it for the next deliver().
+    void publish(ChangeKind kind, uint64_t seq, const Point& point);
+
+    // Offers the published events to the subscribers, in sequence order.
+    // Called without the database lock, it may wait for Block subscribers.
+    void deliver();
+
+    // Closes every subscription, e.g. when the database is closed.
+    void closeAll();
+
+    // Closes every subscription as lagged and drops the retained events, for
+    // when the changes up to `lastSeq` are unknown.
+    void disconnectAll(uint64_t lastSeq);
+
+private:
+    void closeSubscribers(bool lagged);
+
+    std::deque<ChangeEvent> retained;
+    size_t retainCapacity = 0;
+    uint64_t retainedAfter = 0;  // Every event after this sequence number is retained
+
+    // Handed from the writers to deliver(). `pendingMutex` guards the events
+    // and the subscriber list, `deliveryMutex` keeps one deliverer at a time,
+    // the single producer of every queue.
+    std::mutex pendingMutex;
+    std::vector<ChangeEvent> pending;
+    std::vector<std::shared_ptr<ChangeSubscription>> subscribers;
+    std::atomic<size_t> subscriberCount{0};
+    std::mutex deliveryMutex;
+};
+
+
+// Delivers the events published during its lifetime once it goes out of
+// scope. Declared before a write's lock guard, so delivery runs after the
+// database lock is released.
+class ChangeDelivery {
+public:
+    explicit ChangeDelivery(ChangeFeed& feed) : feed(feed) {}
+    ~ChangeDelivery() { feed.deliver(); }
+
+    ChangeDelivery(const ChangeDelivery&) = delete;
+    ChangeDelivery& operator=(const ChangeDelivery&) = delete;
+
+private:
+    ChangeFeed& feed;
+};
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "csvparse.hpp"
+
+
+// Row codecs.
+// A codec decodes the cells of one CSV row into a Point and encodes a Point
+// back into cells. The schema is known when a database is opened, so common
+// column layouts get a codec generated at compile time (TypedRowCodec), with
+// no per-cell type dispatch. Everything else goes through DynamicRowCodec.
+
+
+// Schema name ("string", "float", "int", "bool") to ColumnType.
+ColumnType columnTypeFromName(const std::string& name);
+
+// Infers column types from the cells of one row, same rules as parseCellGeneric.
+std::vector<ColumnType> inferColumnTypes(const std::vector<std::string>& cells);
+
+
+// Cell level parsing and formatting, shared by all codecs.
+// parseCell returns false if the text does not match the column type.
+namespace codec {
+
+inline bool parseCell(const std::string& text, double& out) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    out = std::strtod(begin, &end);
+    return end != begin && *end == '\0';
+}
+
+inline bool parseCell(const std::string& text, int& out) {
+    const char* begin = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    long value = std::strtol(begin, &end, 10);
+    if (end == begin || *end != '\0' || errno == ERANGE || value < INT_MIN || value > INT_MAX) {
+        return false;
+    }
+    out = static_cast<int>(value);
+    return true;
+}
+
+inline bool parseCell(const std::string& text, bool& out) {
+    auto equalsIgnoreCase = [&text](const char* word, size_t length) {
+        if (text.size() != length) {
+            return false;
+        }
+        for (size_t i = 0; i < length; ++i) {
+            if (std::tolower(static_cast<unsigned char>(text[i])) != word[i]) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (equalsIgnoreCase("true", 4)) {
+        out = true;
+        return true;
+    }
+    if (equalsIgnoreCase("false", 5)) {
+        out = false;
+        return true;
+    }
+    return false;
+}
+
+inline bool parseCell(const std::string& text, std::string& out) {
+    out = text;
+    return true;
+}
+
+inline void formatCell(double value, std::string& out) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+    out.assign(buffer, length);
+}
+
+inline void formatCell(int value, std::string& out) {
+    char buffer[16];
+    int length = std::snprintf(buffer, sizeof(buffer), "%d", value);
+    out.assign(buffer, length);
+}
+
+inline void formatCell(bool value, std::string& out) {
+    out.assign(value ? "true" : "false");
+}
+
+inline void formatCell(const std::string& value, std::string& out) {
+    out.assign(value);
+}
+
+// Time column, first cell of a row.
+inline void parseTime(const std::vector<std::string>& cells, Point& point) {
+    if (cells.empty() || !parseCell(cells[0], point.time)) {
+        throw std::invalid_argument("Invalid time value in row");
+    }
+}
+
+// Time column, formatted like std::to_string.
+inline void formatTime(double time, std::string& out) {
+    char buffer[64];
+    int length = std::snprintf(buffer, sizeof(buffer), "%f", time);
+    if (length >= 0 && length < static_cast<int>(sizeof(buffer))) {
+        out.assign(buffer, length);
+    } else {
+        out = std::to_string(time);
+    }
+}
+
+// Converts a cell to T in place. Numbers are converted to the column type,
+// anything else is formatted as text for string columns. Int columns take
+// integral numbers in range only, a fraction or NaN throws like unparsable text.
+template <typename T>
+void coerceCell(PointRow& row) {
+    if (std::holds_alternative<T>(row.data)) {
+        return;
+    }
+
+    if constexpr (std::is_same_v<T, std::string>) {
+        std::string text;
+        std::visit([&text](const auto& value) { formatCell(value, text); }, row.data);
+        row.data = std::move(text);
+    } else {
+        double value;
+        if (numericValue(row, value)) {
+            if constexpr (std::is_same_v<T, int>) {
+                if (!(value >= INT_MIN && value <= INT_MAX) || std::trunc(value) != value) {
+                    std::string text;
+                    formatCell(value, text);
+                    throw std::invalid_argument("Value does not match the column type: " + text);
+                }
+            }
+            row.data = static_cast<T>(value);
+        } else {
+            T parsed;
+            if (!parseCell(std::get<std::string>(row.data), parsed)) {
+                throw std::invalid_argument("Value does not match the column type: " + std::get<std::string>(row.data));
+            }
+            row.data = parsed;
+        }
+    }
+}
+
+template <typename T>
+constexpr ColumnType columnTypeOf() {
+    if constexpr (std::is_same_v<T, double>) {
+        return ColumnType::Double;
+    } else if constexpr (std::is_same_v<T, int>) {
+        return ColumnType::Int;
+    } else if constexpr (std::is_same_v<T, bool>) {
+        return ColumnType::Bool;
+    } else {
+        return ColumnType::String;
+    }
+}
+
+}  // namespace codec
+
+
+class RowCodec {
+public:
+    virtual ~RowCodec() = default;
+
+    // Column types, one per non-time column. Empty for an untyped codec.
+    const std::vector<ColumnType>& types() const { return columnTypes; }
+
+    // Decodes row cells, time first, into a point. Throws if the time is invalid.
+    // Cells that do not match their column type are decoded with parseCellGeneric.
+    virtual void parse(const std::vector<std::string>& cells, Point& point) const = 0;
+
+    // Encodes a point into cells, time first. Reuses the strings in `out`.
+    virtual void serialize(const Point& point, std::vector<std::string>& out) const = 0;
+
+    // Converts the cells of a point to the column types in place.
+    virtual void coerce(Point& point) const = 0;
+
+protected:
+    std::vector<ColumnType> columnTypes;
+};
+
+
+// Codec for a fixed column layout, e.g. TypedRowCodec<double, double, int, bool>.
+// Every column is decoded and encoded with its concrete type, the loops over
+// columns are unrolled at compile time.
+template <typename... Ts>
+class TypedRowCodec : public RowCodec {
+public:
+    TypedRowCodec() {
+        columnTypes = {codec::columnTypeOf<Ts>()...};
+    }
+
+    void parse(const std::vector<std::string>& cells, Point& point) const override {
+        codec::parseTime(cells, point);
+        point.rows.resize(sizeof...(Ts));
+        parseColumns(cells, point, std::index_sequence_for<Ts...>{});
+    }
+
+    void serialize(const Point& point, std::vector<std::string>& out) const override {
+        out.resize(sizeof...(Ts) + 1);
+        codec::formatTime(point.time, out[0]);
+        serializeColumns(point, out, std::index_sequence_for<Ts...>{});
+    }
+
+    void coerce(Point& point) const override {
+        if (point.rows.size() != sizeof...(Ts)) {
+            throw std::invalid_argument("Point does not match the number of schema columns");
+        }
+        coerceColumns(point, std::index_sequence_for<Ts...>{});
+    }
+
+private:
+    template <typename T>
+    static void parseColumn(const std::string& text, PointRow& row) {
+        T value;
+        if (codec::parseCell(text, value)) {
+            row.data = std::move(value);
+        } else {
+            row = parseCellGeneric(text);
+        }
+    }
+
+    template <typename T>
+    static void serializeColumn(const PointRow& row, std::string& out) {
+        if (const T* value = std::get_if<T>(&row.data)) {
+            codec::formatCell(*value, out);
+        } else {
+            std::visit([&out](const auto& other) { codec::formatCell(other, out); }, row.data);
+        }
+    }
+
+    template <size_t... Is>
+    static void parseColumns(const std::vector<std::string>& cells, Point& point, std::index_sequence<Is...>) {
+        static const std::string missing;
+        (parseColumn<Ts>(Is + 1 < cells.size() ? cells[Is + 1] : missing, point.rows[Is]), ...);
+    }
+
+    template <size_t... Is>
+    static void serializeColumns(const Point& point, std::vector<std::string>& out, std::index_sequence<Is...>) {
+        (serializeColumn<Ts>(point.rows[Is], out[Is + 1]), ...);
+    }
+
+    template <size_t... Is>
+    static void coerceColumns(Point& point, std::index_sequence<Is...>) {
+        (codec::coerceCell<Ts>(point.rows[Is]), ...);
+    }
+};
+
+
+// Codec for any layout. Dispatches on the column type at runtime; without
+// column types every cell is decoded with parseCellGeneric.
+class DynamicRowCodec : public RowCodec {
+public:
+    explicit DynamicRowCodec(const std::vector<ColumnType>& types);
+
+    void parse(const std::vector<std::string>& cells, Point& point) const override;
+    void serialize(const Point& point, std::vector<std::string>& out) const override;
+    void coerce(Point& point) const override;
+};
+
+
+// Returns the compile-time codec for common layouts, DynamicRowCodec otherwise.
+std::unique_ptr<RowCodec> makeRowCodec(const std::vector<ColumnType>& types);
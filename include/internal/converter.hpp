@@ -2,6 +2,8 @@
 #include <pybind11/pybind11.h>
 #include <Python.h>
 #include <cstring>
+#include "codec.hpp"
+#include "arrow.hpp"
 
 #ifdef _MSC_VER
     #include <BaseTsd.h>
@@ -12,6 +14,55 @@
 
 namespace py = pybind11;
 
+// Writes one column of the structured array. T is the column type, the loop
+// only falls back to a conversion for cells stored with another type.
+template <typename T, typename Out>
+void fillColumn(const std::vector<Point>& points, size_t col, char* base, size_t stride, size_t offset) {
+    for (size_t row = 0; row < points.size(); ++row) {
+        const auto& rows = points[row].rows;
+        Out* field_ptr = reinterpret_cast<Out*>(base + row * stride + offset);
+        if (col >= rows.size()) {
+            *field_ptr = Out{};
+        } else if (const T* value = std::get_if<T>(&rows[col].data)) {
+            *field_ptr = static_cast<Out>(*value);
+        } else {
+            double value = 0.0;
+            numericValue(rows[col], value);
+            *field_ptr = static_cast<Out>(value);
+        }
+    }
+}
+
+
+// Writes a string column as fixed-size UTF-32 (simple conversion for ASCII strings).
+inline void fillStringColumn(const std::vector<Point>& points, size_t col, char* base, size_t stride,
+                             size_t offset, size_t field_size) {
+    size_t max_field_chars = field_size / sizeof(char32_t) - 1;
+    std::string converted;
+    for (size_t row = 0; row < points.size(); ++row) {
+        char* field_ptr = base + row * stride + offset;
+        std::memset(field_ptr, 0, field_size);
+
+        const auto& rows = points[row].rows;
+        if (col >= rows.size()) {
+            continue;
+        }
+
+        const std::string* str = std::get_if<std::string>(&rows[col].data);
+        if (str == nullptr) {
+            std::visit([&converted](const auto& value) { codec::formatCell(value, converted); }, rows[col].data);
+            str = &converted;
+        }
+
+        char32_t* u32_ptr = reinterpret_cast<char32_t*>(field_ptr);
+        size_t max_chars = (str->length() < max_field_chars) ? str->length() : max_field_chars;
+        for (size_t i = 0; i < max_chars; ++i) {
+            u32_ptr[i] = static_cast<char32_t>(static_cast<unsigned char>((*str)[i]));
+        }
+    }
+}
+
+
 py::array convertToStructuredArray(const CSVData& csv) {
     const auto& headers = csv.headers;
     const auto& points = csv.points;
@@ -21,32 +72,54 @@ py::array convertToStructuredArray(const CSVData& csv) {
     }
 
     size_t num_rows = points.size();
-    const auto& first_point = points[0];
+
+    // Column types come from the schema when known, otherwise from the first row.
+    std::vector<ColumnType> types = csv.types;
+    if (types.size() + 1 != headers.size()) {
+        types.clear();
+        const auto& first_point = points[0];
+        for (size_t i = 0; i < first_point.rows.size(); ++i) {
+            const auto& variant = first_point.rows[i].data;
+            if (std::holds_alternative<int>(variant)) {
+                types.push_back(ColumnType::Int);
+            } else if (std::holds_alternative<double>(variant)) {
+                types.push_back(ColumnType::Double);
+            } else if (std::holds_alternative<std::string>(variant)) {
+                types.push_back(ColumnType::String);
+            } else if (std::holds_alternative<bool>(variant)) {
+                types.push_back(ColumnType::Bool);
+            } else {
+                throw std::runtime_error("Unsupported data type in first row");
+            }
+        }
+    }
+
+    if (types.size() + 1 > headers.size()) {
+        throw std::runtime_error("Mismatch between headers and data columns");
+    }
+
     std::vector<std::pair<std::string, py::dtype>> fields;
 
     // Create field for time (assuming it's always the first column)
     fields.emplace_back(headers[0], py::dtype::of<double>());
 
     // Create fields for the rest of the columns based on the data types
-    for (size_t i = 0; i < first_point.rows.size(); ++i) {
-        const auto& variant = first_point.rows[i].data;
-        size_t header_idx = i + 1;
-        
-        if (header_idx >= headers.size()) {
-            throw std::runtime_error("Mismatch between headers and data columns");
-        }
-
-        if (std::holds_alternative<int>(variant)) {
-            fields.emplace_back(headers[header_idx], py::dtype::of<int32_t>());
-        } else if (std::holds_alternative<double>(variant)) {
-            fields.emplace_back(headers[header_idx], py::dtype::of<double>());
-        } else if (std::holds_alternative<std::string>(variant)) {
-            // Use a reasonable fixed-size string - 256 characters should handle most cases
-            fields.emplace_back(headers[header_idx], py::dtype("U256"));
-        } else if (std::holds_alternative<bool>(variant)) {
-            fields.emplace_back(headers[header_idx], py::dtype::of<bool>());
-        } else {
-            throw std::runtime_error("Unsupported data type in first row");
+    for (size_t i = 0; i < types.size(); ++i) {
+        const std::string& name = headers[i + 1];
+        switch (types[i]) {
+            case ColumnType::Int:
+                fields.emplace_back(name, py::dtype::of<int32_t>());
+                break;
+            case ColumnType::Double:
+                fields.emplace_back(name, py::dtype::of<double>());
+                break;
+            case ColumnType::String:
+                // Use a reasonable fixed-size string - 256 characters should handle most cases
+                fields.emplace_back(name, py::dtype("U256"));
+                break;
+            case ColumnType::Bool:
+                fields.emplace_back(name, py::dtype::of<bool>());
+                break;
         }
     }
 
@@ -60,55 +133,270 @@ py::array convertToStructuredArray(const CSVData& csv) {
     std::vector<int> shape = {static_cast<int>(num_rows)};
     py::array result(dtype, shape);
     char* base_ptr = static_cast<char*>(result.mutable_data());
+    size_t stride = static_cast<size_t>(dtype.itemsize());
 
     // Calculate field offsets
-    std::vector<int> offsets;
-    int offset = 0;
+    std::vector<size_t> offsets;
+    size_t offset = 0;
     for (const auto& field : fields) {
         offsets.push_back(offset);
         offset += field.second.itemsize();
     }
 
-    // Populate the array
+    // Populate the array one column at a time, with one type dispatch per column
     for (size_t row = 0; row < num_rows; ++row) {
-        const auto& point = points[row];
-        char* row_ptr = base_ptr + row * dtype.itemsize();
+        *reinterpret_cast<double*>(base_ptr + row * stride + offsets[0]) = points[row].time;
+    }
+
+    for (size_t col = 0; col < types.size(); ++col) {
+        size_t field_offset = offsets[col + 1];
+        switch (types[col]) {
+            case ColumnType::Int:
+                fillColumn<int, int32_t>(points, col, base_ptr, stride, field_offset);
+                break;
+            case ColumnType::Double:
+                fillColumn<double, double>(points, col, base_ptr, stride, field_offset);
+                break;
+            case ColumnType::Bool:
+                fillColumn<bool, bool>(points, col, base_ptr, stride, field_offset);
+                break;
+            case ColumnType::String:
+                fillStringColumn(points, col, base_ptr, stride, field_offset, fields[col + 1].second.itemsize());
+                break;
+        }
+    }
 
-        // Set the time field (first field)
-        *reinterpret_cast<double*>(row_ptr + offsets[0]) = point.time;
+    return result;
+}
 
-        // Set the remaining fields
-        size_t point_rows_size = point.rows.size();
-        size_t fields_size_minus_one = fields.size() - 1;
-        size_t max_cols = (point_rows_size < fields_size_minus_one) ? point_rows_size : fields_size_minus_one;
-        for (size_t col = 0; col < max_cols; ++col) {
-            char* field_ptr = row_ptr + offsets[col + 1];
-            const auto& variant = point.rows[col].data;
 
-            if (std::holds_alternative<int>(variant)) {
-                *reinterpret_cast<int32_t*>(field_ptr) = std::get<int>(variant);
-            } else if (std::holds_alternative<double>(variant)) {
-                *reinterpret_cast<double*>(field_ptr) = std::get<double>(variant);
-            } else if (std::holds_alternative<std::string>(variant)) {
-                const std::string& str = std::get<std::string>(variant);
-                size_t field_size = fields[col + 1].second.itemsize();
-                
-                // Zero the field
-                std::memset(field_ptr, 0, field_size);
-                
-                // Simple UTF-32 conversion for ASCII strings
-                char32_t* u32_ptr = reinterpret_cast<char32_t*>(field_ptr);
-                size_t max_chars = (str.length() < (field_size / sizeof(char32_t) - 1)) ? 
-                                   str.length() : (field_size / sizeof(char32_t) - 1);
-                
-                for (size_t i = 0; i < max_chars; ++i) {
-                    u32_ptr[i] = static_cast<char32_t>(static_cast<unsigned char>(str[i]));
+// Encodes one UTF-32 code point as UTF-8.
+inline void appendUtf8(std::string& out, char32_t cp) {
+    if (cp < 0x80) {
+        out.push_back(static_cast<char>(cp));
+    } else if (cp < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else if (cp < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+    }
+}
+
+
+// Builds Points column by column from NumPy arrays.
+// Every column is read straight from its buffer with one type dispatch per
+// column, no Python objects are created for numeric or fixed-width string data.
+std::vector<Point> convertFromArrays(py::array times, const py::list& columns) {
+    auto timeArray = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(times);
+    if (!timeArray || timeArray.ndim() != 1) {
+        throw std::runtime_error("times must be a one dimensional array");
+    }
+
+    size_t num_rows = static_cast<size_t>(timeArray.shape(0));
+    const double* time_ptr = timeArray.data();
+
+    std::vector<Point> points(num_rows);
+    for (size_t row = 0; row < num_rows; ++row) {
+        points[row].time = time_ptr[row];
+        points[row].rows.reserve(columns.size());
+    }
+
+    for (const auto& item : columns) {
+        py::array column = py::array::ensure(item);
+        if (!column || column.ndim() != 1 || static_cast<size_t>(column.shape(0)) != num_rows) {
+            throw std::runtime_error("Every column must be a one dimensional array with one value per time");
+        }
+
+        char kind = column.dtype().kind();
+        if (kind == 'f') {
+            auto values = py::array_t<double, py::array::c_style | py::array::forcecast>::ensure(column);
+            const double* ptr = values.data();
+            for (size_t row = 0; row < num_rows; ++row) {
+                points[row].rows.push_back({ptr[row]});
+            }
+        } else if (kind == 'i' || kind == 'u') {
+            auto values = py::array_t<int32_t, py::array::c_style | py::array::forcecast>::ensure(column);
+            const int32_t* ptr = values.data();
+            for (size_t row = 0; row < num_rows; ++row) {
+                points[row].rows.push_back({static_cast<int>(ptr[row])});
+            }
+        } else if (kind == 'b') {
+            auto values = py::array_t<bool, py::array::c_style | py::array::forcecast>::ensure(column);
+            const bool* ptr = values.data();
+            for (size_t row = 0; row < num_rows; ++row) {
+                points[row].rows.push_back({ptr[row]});
+            }
+        } else if (kind == 'U' || kind == 'S') {
+            py::array contiguous = py::array::ensure(column, py::array::c_style);
+            const char* base = static_cast<const char*>(contiguous.data());
+            size_t itemsize = static_cast<size_t>(contiguous.itemsize());
+            for (size_t row = 0; row < num_rows; ++row) {
+                std::string value;
+                const char* cell = base + row * itemsize;
+                if (kind == 'S') {
+                    value.assign(cell, strnlen(cell, itemsize));
+                } else {
+                    const char32_t* u32_ptr = reinterpret_cast<const char32_t*>(cell);
+                    for (size_t i = 0; i < itemsize / sizeof(char32_t) && u32_ptr[i] != 0; ++i) {
+                        appendUtf8(value, u32_ptr[i]);
+                    }
                 }
-            } else if (std::holds_alternative<bool>(variant)) {
-                *reinterpret_cast<bool*>(field_ptr) = std::get<bool>(variant);
+                points[row].rows.push_back({std::move(value)});
+            }
+        } else if (kind == 'O') {
+            // Object arrays (e.g. pandas strings) need one cast per cell.
+            for (size_t row = 0; row < num_rows; ++row) {
+                points[row].rows.push_back({py::str(column[py::int_(row)]).cast<std::string>()});
             }
+        } else {
+            throw std::runtime_error("Unsupported column dtype for bulk import");
         }
     }
 
-    return result;
+    return points;
+}
+
+
+// Arrow PyCapsule interface (see arrow.hpp). A capsule owns the struct it
+// points to and releases it when collected, unless a consumer moved it out.
+template <typename T>
+void releaseArrowCapsule(PyObject* capsule, const char* name) {
+    T* value = static_cast<T*>(PyCapsule_GetPointer(capsule, name));
+    if (value == nullptr) {
+        PyErr_Clear();
+        return;
+    }
+    if (value->release != nullptr) {
+        value->release(value);
+    }
+    delete value;
+}
+
+
+inline void releaseSchemaCapsule(PyObject* capsule) {
+    releaseArrowCapsule<ArrowSchema>(capsule, "arrow_schema");
+}
+
+
+inline void releaseArrayCapsule(PyObject* capsule) {
+    releaseArrowCapsule<ArrowArray>(capsule, "arrow_array");
+}
+
+
+inline void releaseStreamCapsule(PyObject* capsule) {
+    releaseArrowCapsule<ArrowArrayStream>(capsule, "arrow_array_stream");
+}
+
+
+template <typename T>
+py::object makeArrowCapsule(T* value, const char* name, PyCapsule_Destructor destructor) {
+    PyObject* capsule = PyCapsule_New(value, name, destructor);
+    if (capsule == nullptr) {
+        value->release(value);
+        delete value;
+        throw py::error_already_set();
+    }
+    return py::reinterpret_steal<py::object>(capsule);
+}
+
+
+inline py::object arrowSchemaCapsule(const ArrowBatch& batch) {
+    auto* schema = new ArrowSchema();
+    exportArrowSchema(batch, schema);
+    return makeArrowCapsule(schema, "arrow_schema", releaseSchemaCapsule);
+}
+
+
+inline py::object arrowArrayCapsule(const std::shared_ptr<const ArrowBatch>& batch) {
+    auto* array = new ArrowArray();
+    exportArrowArray(batch, array);
+    return makeArrowCapsule(array, "arrow_array", releaseArrayCapsule);
+}
+
+
+inline py::object arrowStreamCapsule(const std::shared_ptr<const ArrowBatch>& batch) {
+    auto* stream = new ArrowArrayStream();
+    exportArrowStream(batch, stream);
+    return makeArrowCapsule(stream, "arrow_array_stream", releaseStreamCapsule);
+}
+
+
+// Releases an imported Arrow struct when leaving scope.
+template <typename T>
+struct ArrowReleaseGuard {
+    T& value;
+    ~ArrowReleaseGuard() {
+        if (value.release != nullptr) {
+            value.release(&value);
+        }
+    }
+};
+
+
+template <typename T>
+T& capsulePointer(const py::handle& capsule, const char* name) {
+    T* value = static_cast<T*>(PyCapsule_GetPointer(capsule.ptr(), name));
+    if (value == nullptr) {
+        throw py::error_already_set();
+    }
+    if (value->release == nullptr) {
+        throw std::invalid_argument(std::string("Arrow ") + name + " was already released");
+    }
+    return *value;
+}
+
+
+// Builds Points from any object implementing the Arrow PyCapsule interface:
+// every batch of __arrow_c_stream__ (tables, data frames), otherwise the
+// record batch of __arrow_c_array__. Buffers are read in place.
+inline std::vector<Point> convertFromArrow(const py::object& source, const std::vector<std::string>& headers,
+                                           const std::vector<ColumnType>& types) {
+    if (py::hasattr(source, "__arrow_c_stream__")) {
+        py::object capsule = source.attr("__arrow_c_stream__")();
+        auto& stream = capsulePointer<ArrowArrayStream>(capsule, "arrow_array_stream");
+        auto streamError = [&stream]() {
+            const char* message = stream.get_last_error(&stream);
+            return std::runtime_error(std::string("Arrow stream failed: ") + (message != nullptr ? message : "unknown error"));
+        };
+
+        ArrowSchema schema{};
+        if (stream.get_schema(&stream, &schema) != 0) {
+            throw streamError();
+        }
+        ArrowReleaseGuard<ArrowSchema> schemaGuard{schema};
+
+        std::vector<Point> points;
+        while (true) {
+            ArrowArray array{};
+            if (stream.get_next(&stream, &array) != 0) {
+                throw streamError();
+            }
+            if (array.release == nullptr) {
+                break;  // End of stream
+            }
+            ArrowReleaseGuard<ArrowArray> arrayGuard{array};
+            std::vector<Point> batch = importArrowArray(schema, array, headers, types);
+            points.insert(points.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+        }
+        return points;
+    }
+
+    if (py::hasattr(source, "__arrow_c_array__")) {
+        py::tuple capsules = source.attr("__arrow_c_array__")();
+        if (capsules.size() != 2) {
+            throw std::invalid_argument("__arrow_c_array__ must return a schema and an array capsule");
+        }
+        const auto& schema = capsulePointer<ArrowSchema>(capsules[0], "arrow_schema");
+        const auto& array = capsulePointer<ArrowArray>(capsules[1], "arrow_array");
+        return importArrowArray(schema, array, headers, types);
+    }
+
+    throw std::invalid_argument("Object does not implement the Arrow PyCapsule interface");
 }
@@ -12,6 +12,8 @@
 
 #include <ciso646>
 
+#include "iobackend.hpp"
+
 
 struct PointRow {
     std::variant<std::string, double, int, bool> data;
@@ -24,9 +26,19 @@ struct Point {
 };
 
 
+// Column types of a schema. Schema names: "string", "float", "int", "bool".
+enum class ColumnType {
+    String,
+    Double,
+    Int,
+    Bool
+};
+
+
 struct CSVData {
     std::vector<std::string> headers;
     std::vector<Point> points;
+    std::vector<ColumnType> types;  // One per non-time column, empty if unknown
 };
 
 
@@ -44,6 +56,14 @@ struct FullIndex {
 };
 
 
+// Sorted run buffer for late (out-of-order) arrivals.
+// Kept sorted by time and merged into the FullIndex on checkpoint,
+// so a late point does not shift the whole index on insert.
+struct MemTable {
+    std::vector<Index> indices;
+};
+
+
 // Tracks new Indices added before disk write. 
 // Only write these Indices.
 struct NewAdded {
@@ -58,27 +78,85 @@ struct DeletedIndices {
 };
 
 
-// Function to parse CSV file and return CSVData structure
-CSVData parseCSV(const std::string& filename, FullIndex& dbIndex);
+// Reads the cells of a csv2 row into `cells`, reusing its strings.
+template <typename Row>
+void readRowCells(const Row& row, std::vector<std::string>& cells) {
+    size_t cell_count = 0;
+    for (const auto& cell : row) {
+        if (cell_count == cells.size()) {
+            cells.emplace_back();
+        }
+        std::string& value = cells[cell_count];
+        value.clear();
+        cell.read_value(value);
+        cell_count++;
+    }
+    cells.resize(cell_count);
+
+    #ifdef _WIN32
+        // Remove trailing '\r' only from the last cell on Windows
+        if (!cells.empty() && !cells.back().empty() && cells.back().back() == '\r') {
+            cells.back().pop_back();
+        }
+    #endif
+}
+
+
+// Function to parse CSV file and return CSVData structure.
+// Cells are decoded with the row codec for `types`. Without types, they are
+// inferred from the first row.
+CSVData parseCSV(const std::string& filename, FullIndex& dbIndex,
+                 const std::vector<ColumnType>& types = {});
+
+// Parses a cell by trying bool, double, int and falling back to string.
+PointRow parseCellGeneric(const std::string& value);
 
 // Function to append a row to CSV data
-CSVData appendRow(CSVData& csv, const Point& point, FullIndex& dbIndex, NewAdded& newAdded);
+CSVData& appendRow(CSVData& csv, Point point, FullIndex& dbIndex, MemTable& memTable, NewAdded& newAdded);
+
+// Function to append a time-sorted batch of rows to CSV data
+CSVData& appendRows(CSVData& csv, std::vector<Point>&& points, FullIndex& dbIndex, NewAdded& newAdded);
 
 // Function to delete a row from CSV data
-CSVData deletePointwithIndex(CSVData& data, int index, double time, FullIndex& dbIndex, DeletedIndices& deletedIndices);
+CSVData& deletePointwithIndex(CSVData& data, int index, double time, FullIndex& dbIndex,
+                              MemTable& memTable, NewAdded& newAdded, DeletedIndices& deletedIndices);
+
+// Reorders rows into time order and renumbers the index to match.
+void sortPointsByTime(CSVData& data, FullIndex& dbIndex);
+
+// Position of a named column in Point::rows, or -1 if it does not exist.
+int findColumn(const std::vector<std::string>& headers, const std::string& name);
+
+// Positions in Point::rows of the named columns, in the given order. The time
+// column is always part of a result and is skipped. Throws std::invalid_argument
+// for unknown names.
+std::vector<int> resolveProjection(const std::vector<std::string>& headers, const std::vector<std::string>& columns);
+
+// Copies the time and the projected cells of `source` into `out`, reusing its row buffer.
+void projectPoint(const Point& source, const std::vector<int>& projection, Point& out);
+
+// Numeric view of a cell (int/bool widened to double). False for strings.
+bool numericValue(const PointRow& row, double& out);
 
 // Point to vector.
 std::vector<std::string> pointToVector(const Point& point);
+void pointToVector(const Point& point, std::vector<std::string>& vec);
+
+// Approximate size of a point once written as a CSV row.
+size_t approximateRowSize(const Point& point);
+
+// Joins cells into one CSV line, appended to `out` with its newline.
+void appendCSVRow(const std::vector<std::string>& row, std::string& out);
 
 // Function to write CSV data to a file ( Complete file rewritten )
-void writeCSV(const std::string& filename, const CSVData& csv);
+void writeCSV(const std::string& filename, const CSVData& csv, const IOOptions& options = {});
 
 // Function to print CSV data to console
 void printCSVData(const CSVData& data);
 
 // File I/O functions
-std::ofstream openFileInAppend(const std::string& filename);
-bool writeToCSV(const CSVData& csv, std::ofstream& file, NewAdded& newAdded);
+std::unique_ptr<FileWriter> openFileInAppend(const std::string& filename, const IOOptions& options = {});
+bool writeToCSV(const CSVData& csv, FileWriter& file, NewAdded& newAdded);
 
 // Binary search and time range query functions
 void insertIndexSorted(FullIndex& fullIndex, const Index& newIndex);
@@ -88,8 +166,17 @@ std::vector<Index> findInTimeRange(
     const FullIndex& fullIndex, double startTime, double endTime);
 int getNextRowNumber(const FullIndex& fullIndex);
 
+// MemTable functions
+void insertMemTable(MemTable& memTable, const Index& newIndex);
+void mergeMemTable(FullIndex& fullIndex, MemTable& memTable);
+std::vector<Index> findInTimeRange(
+    const FullIndex& fullIndex, const MemTable& memTable, double startTime, double endTime);
+void findInTimeRange(const FullIndex& fullIndex, const MemTable& memTable,
+    double startTime, double endTime, std::vector<Index>& out);
+const Index* findExactTime(const FullIndex& fullIndex, const MemTable& memTable, double time);
+
 // Append Only DB Functions
-bool writeToCSV(const CSVData& csv, std::ofstream& file, NewAdded& newAdded);
+bool writeToCSV(const CSVData& csv, FileWriter& file, NewAdded& newAdded);
 
 // Main DB Functions.
 bool atomicWrite(const std::string& filename, const CSVData& csv, NewAdded& newAdded);
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+
+
+// When pending writes are committed to the data file.
+enum class DurabilityMode {
+    OpCount,       // Commit every CHECKPOINT operations on the writing thread (default)
+    None,          // Commit only on checkpoint()/close(), never fsync
+    IntervalMs,    // Background flusher commits every `intervalMs`
+    Bytes,         // Background flusher commits once `bytes` of rows are pending
+    EveryOpFsync   // Every operation is committed and fsynced before it returns
+};
+
+
+// Durability policy of a StampDB. Every mode except None fsyncs on commit.
+// Commits are tracked by sequence number, see StampDB::waitForCommit.
+struct DurabilityPolicy {
+    DurabilityMode mode = DurabilityMode::OpCount;
+    int intervalMs = 100;        // IntervalMs: flush period
+    size_t bytes = 1 << 20;      // Bytes: approximate size of pending rows that triggers a flush
+};
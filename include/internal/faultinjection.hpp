@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+
+// Fault injection for crash-consistency tests.
+// While a fault plan is armed every storage I/O operation (data and sidecar
+// writes, fsyncs, renames) is counted, and the planned operation fails, is torn
+// or crashes. A simulated crash leaves the files as a killed process would: the
+// crashing operation and everything after it never reach the disk. Tests then
+// drop the database without closing it, disarm the plan and reopen.
+
+
+enum class FaultSite {
+    Write,
+    Sync,
+    Rename
+};
+
+
+enum class FaultKind {
+    Fail,   // The operation reports an I/O error, the process carries on
+    Torn,   // Only a prefix of the write persists, then the process crashes
+    Crash   // The process crashes before the operation
+};
+
+
+struct FaultPlan {
+    uint64_t operation = 0;       // 1-based operation to fault, 0 only counts operations
+    FaultKind kind = FaultKind::Crash;
+    double tornFraction = 0.5;    // Part of a torn write that persists
+};
+
+
+// Thrown by a simulated crash. Deliberately not a std::exception, so code that
+// recovers from I/O errors cannot swallow it.
+struct SimulatedCrash {
+    std::string message;
+
+    const char* what() const noexcept { return message.c_str(); }
+};
+
+
+// Arming resets the operation count and the crashed state.
+void armFaults(const FaultPlan& plan);
+void disarmFaults();
+bool faultsArmed();
+
+// Operations seen since the plan was armed, and whether the planned one was reached.
+uint64_t faultOperationCount();
+bool faultTriggered();
+
+
+// Outcome of an I/O operation under the fault plan.
+enum class FaultAction {
+    Proceed,
+    Fail,
+    Torn
+};
+
+// Called right before an I/O operation on `path`. A crash throws SimulatedCrash.
+// For Torn, `size` is shortened to the prefix that persists: the caller writes
+// it and then calls crashAfterTornWrite. Operations without a size cannot tear
+// and crash instead. After a crash every operation returns Fail, so destructors
+// running during unwinding do not write either.
+FaultAction injectFault(FaultSite site, const std::string& path, size_t* size = nullptr);
+
+[[noreturn]] void crashAfterTornWrite(const std::string& path);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
 #include <thread>
@@ -10,3 +11,10 @@
 // Shadow Copy and Atomic Renames
 bool createShadowCopy(const std::string& path);
 bool swapShadowAsDb(const std::string& path, int maxRetries = 5);
+
+// Durability
+// Makes a create or rename inside the directory of `path` durable. No-op on Windows.
+bool syncDirectory(const std::string& path);
+// Cuts a partial last row, left by an interrupted append, behind `committedSize`.
+// Returns true if the file was truncated.
+bool truncatePartialTail(const std::string& path, uint64_t committedSize);
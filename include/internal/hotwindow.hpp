@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "csvparse.hpp"
+#include "parallel.hpp"
+
+
+// Hot window: the newest points in a fixed-capacity ring.
+// The ring holds the last `capacity` in-order points, optionally only those
+// within `seconds` of the newest one. Every point with a time at or after the
+// oldest ring entry is in the ring, so a query starting there is answered from
+// it without touching the index or taking the database lock.
+//
+// One writer (the database, under its lock) publishes entries with atomic
+// stores; readers never block. An entry is immutable once published and is
+// tagged with its sequence number, so a reader that was lapped by the writer
+// notices and falls back to the main store. Replaced entries are freed by
+// epoch-based reclamation: every reader announces the epoch it started in,
+// and an entry is freed once all active readers started after it was
+// replaced, so readers that keep overlapping do not hold memory back. Late
+// points, updates and deletes inside the window clear the ring; it refills
+// with the following appends.
+
+
+struct HotWindowStats {
+    size_t points = 0;
+    double oldestTime = 0.0;
+    double newestTime = 0.0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    size_t retired = 0;  // Replaced entries and rings not freed yet
+};
+
+
+class HotWindow {
+public:
+    HotWindow() = default;
+    ~HotWindow();
+
+    HotWindow(const HotWindow&) = delete;
+    HotWindow& operator=(const HotWindow&) = delete;
+
+    // Writer side, called under the database lock.
+
+    // Replaces the ring. `newest` are the newest points of the database in time
+    // order, they seed the ring before it is published. A capacity of 0 disables it.
+    void configure(size_t capacity, double seconds, const std::vector<std::string>& headers,
+                   const std::vector<ColumnType>& types, const std::vector<const Point*>& newest);
+
+    bool enabled() const;
+
+    // Adds a point newer than every point in the database.
+    void push(const Point& point);
+
+    // A point at `time` was inserted late, updated or deleted. Clears the ring
+    // if `time` falls inside it.
+    void invalidate(double time);
+
+    void clear();
+
+    // Reader side, safe without the database lock. Each returns false if the
+    // query is not covered by the ring, the caller then uses the main store.
+
+    bool read(double time, const std::vector<std::string>& columns, CSVData& result);
+    bool readRange(double startTime, double endTime, const std::vector<std::string>& columns, CSVData& result);
+    bool aggregate(double startTime, double endTime, const std::string& column, RangeAggregate& result);
+
+    HotWindowStats stats() const;
+
+private:
+    struct Entry {
+        uint64_t seq;
+        Point point;
+    };
+
+    struct Ring {
+        size_t capacity = 0;
+        double seconds = 0.0;
+        std::vector<std::string> headers;
+        std::vector<ColumnType> types;
+        std::unique_ptr<std::atomic<Entry*>[]> slots;
+        std::atomic<uint64_t> head{0};  // Sequence number of the next entry
+        std::atomic<uint64_t> tail{0};  // Oldest entry still in the window
+
+        ~Ring();
+    };
+
+    // Entries [first, last) of a reader snapshot, all checked against their sequence number.
+    struct Snapshot {
+        const Ring* ring = nullptr;
+        uint64_t first = 0;
+        uint64_t last = 0;
+    };
+
+    bool snapshot(double startTime, Snapshot& snap) const;
+    static const Entry* entryAt(const Ring& ring, uint64_t seq);
+    // First entry in [first, last) at or, with `after`, past `time`. Sets
+    // `lapped` if an entry was overwritten meanwhile.
+    static uint64_t lowerBound(const Ring& ring, uint64_t first, uint64_t last, double time, bool after,
+                               bool& lapped);
+    bool copyRange(const Snapshot& snap, uint64_t first, uint64_t last,
+                   const std::vector<std::string>& columns, CSVData& result);
+
+    void publish(Ring* ring, const Point& point);
+    void reclaim();
+
+    // Readers announce their epoch in a slot they claim for one query; 0 marks
+    // a free slot. A reader that finds every slot taken uses the main store.
+    static constexpr size_t READER_SLOTS = 64;
+    // Entries retired between two reclamation passes.
+    static constexpr size_t RECLAIM_BATCH = 64;
+
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> epoch{0};
+    };
+
+    class ReaderGuard;
+
+    template <typename T>
+    struct Retired {
+        uint64_t epoch;  // Epoch it was replaced in
+        T* object;
+    };
+
+    std::atomic<Ring*> ring{nullptr};
+    std::atomic<uint64_t> epoch{1};
+    mutable ReaderSlot readerSlots[READER_SLOTS];
+    mutable std::atomic<uint64_t> hits{0};
+    mutable std::atomic<uint64_t> misses{0};
+    std::atomic<size_t> retiredCount{0};
+
+    // Writer only: replaced entries and rings, in epoch order, waiting for
+    // the readers that may still see them.
+    std::vector<Retired<Entry>> retiredEntries;
+    std::vector<Retired<Ring>> retiredRings;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+// Storage I/O backends.
+// Data files are written through a FileWriter: a sequential writer with its
+// own large buffer. The POSIX backend issues plain write(2) calls. The io_uring
+// backend (Linux, built with STAMPDB_WITH_IO_URING) keeps several buffers in
+// flight at once and can bypass the page cache with O_DIRECT, so large
+// rewrites do not evict data that readers are using.
+
+
+enum class IOBackendKind {
+    Posix,
+    IoUring
+};
+
+
+struct IOOptions {
+    IOBackendKind backend = IOBackendKind::Posix;
+    bool directIO = false;        // Bypass the page cache for full rewrites
+    unsigned queueDepth = 4;      // io_uring: writes in flight
+    size_t bufferSize = 1 << 20;  // Bytes per write, rounded up to the alignment for O_DIRECT
+    bool sync = false;            // fsync before close
+};
+
+
+class FileWriter {
+public:
+    virtual ~FileWriter() = default;
+
+    // Buffers `size` bytes, writing full buffers out as they fill up.
+    virtual bool write(const char* data, size_t size) = 0;
+
+    // Writes what is buffered, waits for all writes, syncs if requested and
+    // closes the file. Returns false if any write failed.
+    virtual bool close() = 0;
+
+    bool write(const std::string& data) {
+        return write(data.data(), data.size());
+    }
+};
+
+
+// Opens `path` for sequential writing, truncating it or appending to it.
+// Returns nullptr if the file cannot be opened. Falls back to the POSIX
+// backend if io_uring is not compiled in or cannot be set up.
+std::unique_ptr<FileWriter> openFileWriter(const std::string& path, bool append, const IOOptions& options);
+
+// True if this build includes the io_uring backend.
+bool ioUringAvailable();
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Rows handed to a worker at a time.
+constexpr size_t MORSEL_SIZE = 8192;
+
+
+// Result of an aggregation over a time range.
+struct RangeAggregate {
+    long long count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+
+    void add(double value);
+    void merge(const RangeAggregate& other);
+};
+
+
+// Resolves a thread count, 0 or less means "all hardware threads".
+int resolveThreadCount(int requested);
+
+// Runs body(begin, end, worker) over [0, total) split into morsels.
+// Idle workers pull the next morsel from a shared cursor, so faster threads
+// take more of the range. Small inputs run inline on the calling thread.
+// `worker` is in [0, threads) and can be used to index per-thread partials.
+template <typename Body>
+void parallelForMorsels(size_t total, int threads, size_t morselSize, const Body& body) {
+    if (total == 0) {
+        return;
+    }
+
+    size_t morsels = (total + morselSize - 1) / morselSize;
+    int workers = static_cast<int>(std::min<size_t>(std::max(threads, 1), morsels));
+
+    if (workers <= 1) {
+        body(size_t(0), total, 0);
+        return;
+    }
+
+    std::atomic<size_t> cursor{0};
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto run = [&](int worker) {
+        try {
+            while (true) {
+                size_t begin = cursor.fetch_add(morselSize, std::memory_order_relaxed);
+                if (begin >= total) {
+                    break;
+                }
+                body(begin, std::min(begin + morselSize, total), worker);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) {
+                error = std::current_exception();
+            }
+            // Stop handing out morsels.
+            cursor.store(total, std::memory_order_relaxed);
+        }
+    };
+
+    // The calling thread is worker 0.
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (int worker = 1; worker < workers; ++worker) {
+        pool.emplace_back(run, worker);
+    }
+    run(0);
+
+    for (auto& thread : pool) {
+        thread.join();
+    }
+
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "csvparse.hpp"
+
+
+// Resampling onto a regular time grid.
+// The grid is start, start + step, ... up to end. Every grid row is written as
+// the time followed by one double per column, so callers can hand in the
+// buffer of a NumPy array with float64 fields. Gaps are NaN.
+
+
+enum class ResampleMethod {
+    Linear,    // Interpolate between the rows around the grid time, no extrapolation
+    Previous,  // Last row at or before the grid time
+    Null       // Last row within one step at or before the grid time
+};
+
+
+// Number of grid times. Throws std::invalid_argument unless step is positive and finite.
+size_t resampleSize(double startTime, double endTime, double step);
+
+// Fills grid rows [first, last) from `index`, sorted by time, in one pass.
+// `positions` are the columns in Point::rows; `out` points at grid row 0.
+void resampleGrid(const CSVData& data, const std::vector<Index>& index, double startTime, double step,
+                  size_t first, size_t last, ResampleMethod method, const std::vector<int>& positions, double* out);
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "csvparse.hpp"
+#include "parallel.hpp"
+
+
+// Query result cache.
+// Results of range reads and aggregates are kept under a memory cap with LRU
+// eviction. Every entry covers the closed time range of its query and is
+// dropped as soon as a write lands inside that range, so a hit is always the
+// result the query would compute right now.
+
+
+struct ResultCacheKey {
+    enum Kind {
+        Range,
+        Aggregate
+    };
+
+    Kind kind = Range;
+    double startTime = 0.0;
+    double endTime = 0.0;
+    std::vector<std::string> columns;  // Projection, empty for all columns
+    std::string predicate;             // Query specific, e.g. the aggregated column
+
+    // False for NaN bounds, which have no order; such queries bypass the cache.
+    bool cacheable() const;
+    bool operator<(const ResultCacheKey& other) const;
+};
+
+
+struct ResultCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t invalidations = 0;
+    size_t entries = 0;
+    size_t bytes = 0;
+    size_t capacity = 0;
+};
+
+
+class ResultCache {
+public:
+    // A capacity of 0 disables the cache.
+    explicit ResultCache(size_t capacityBytes = 0);
+
+    bool enabled() const { return capacityBytes > 0; }
+
+    // Changes the memory cap, evicting entries as needed. 0 clears and disables.
+    void setCapacity(size_t bytes);
+
+    // Lookups mark the entry as most recently used. nullptr on a miss.
+    const CSVData* findRows(const ResultCacheKey& key);
+    const RangeAggregate* findAggregate(const ResultCacheKey& key);
+
+    // Results larger than the whole capacity are not cached.
+    void putRows(const ResultCacheKey& key, const CSVData& rows);
+    void putAggregate(const ResultCacheKey& key, const RangeAggregate& aggregate);
+
+    // Drops entries whose range contains `time`, or any of the sorted `times`.
+    void invalidate(double time);
+    void invalidate(const std::vector<double>& sortedTimes);
+
+    void clear();
+    ResultCacheStats stats() const;
+
+private:
+    struct Entry {
+        ResultCacheKey key;
+        CSVData rows;
+        RangeAggregate aggregate;
+        size_t bytes = 0;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void insert(Entry entry);
+    void erase(EntryList::iterator it);
+    void evictToCapacity();
+
+    size_t capacityBytes;
+    size_t usedBytes = 0;
+    EntryList lru;  // Most recently used first
+    std::map<ResultCacheKey, EntryList::iterator> entries;
+    ResultCacheStats counters;
+};
+
+
+// Approximate heap footprint of a result.
+size_t approximateResultBytes(const CSVData& rows);
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <limits>
+
+#include "csvparse.hpp"
+
+
+// Definition of a materialized rollup (continuous aggregate).
+// Supported aggregates: "count", "sum", "mean", "min", "max".
+struct RollupSpec {
+    std::string name;
+    double bucketWidth;
+    std::vector<std::string> columns;
+    std::vector<std::string> aggregates;
+};
+
+
+// Aggregate state of one column inside one bucket.
+struct RollupCell {
+    long long count = 0;
+    double sum = 0.0;
+    double min = std::numeric_limits<double>::infinity();
+    double max = -std::numeric_limits<double>::infinity();
+};
+
+
+// One time bucket, [start, start + bucketWidth).
+struct RollupBucket {
+    long long points = 0;           // Number of points in the bucket
+    bool stale = false;             // min/max need a rescan after a deletion
+    std::vector<RollupCell> cells;  // One per rollup column
+};
+
+
+// A rollup and its precomputed buckets, keyed by bucket start time.
+struct Rollup {
+    RollupSpec spec;
+    std::vector<int> columnIndices;  // Positions in Point::rows
+    std::map<double, RollupBucket> buckets;
+};
+
+
+// Rollup construction and maintenance
+Rollup makeRollup(const RollupSpec& spec, const std::vector<std::string>& headers);
+bool sameRollupSpec(const RollupSpec& a, const RollupSpec& b);
+double rollupBucketStart(const Rollup& rollup, double time);
+void rollupAdd(Rollup& rollup, const Point& point);
+void rollupRemove(Rollup& rollup, const Point& point);
+void rollupRebuildBucket(Rollup& rollup, double bucketStart, const std::vector<const Point*>& points);
+
+// Rollup queries. Returns one row per non-empty bucket in [startTime, endTime].
+CSVData queryRollup(const Rollup& rollup, double startTime, double endTime);
+
+// Rollup persistence ( Complete file rewritten )
+void writeRollups(const std::string& filename, const std::vector<Rollup>& rollups);
+std::vector<Rollup> readRollups(const std::string& filename, const std::vector<std::string>& headers);
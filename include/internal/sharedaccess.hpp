@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+
+// Shared access across processes.
+// One process opens a database for writing and holds an advisory lock on
+// `<file>.lock` while it is open; any number of processes open it read-only
+// next to it. The writer only appends to the data file or replaces it with a
+// rename, and publishes every commit through the sparse index sidecar, which
+// serves as the manifest (see sparseindex.hpp). Readers never look past the
+// size recorded there, so bytes they have seen never change under them.
+
+
+enum class OpenMode {
+    ReadWrite,  // Takes the writer lock, throws if another process holds it
+    ReadOnly    // Never writes, picks up the writer's commits with refresh()
+};
+
+
+// Exclusive advisory lock held through an open lock file. Released, and the
+// file removed, by release() or the destructor; the OS drops it if the
+// process dies.
+class WriterLock {
+public:
+    WriterLock() = default;
+    ~WriterLock();
+
+    WriterLock(const WriterLock&) = delete;
+    WriterLock& operator=(const WriterLock&) = delete;
+
+    // Takes the lock without blocking. Returns false if another process, or
+    // another database object in this one, holds it. Throws if the lock file
+    // cannot be opened.
+    bool acquire(const std::string& path);
+    void release();
+    bool held() const;
+
+private:
+    int fd = -1;
+    std::string path;
+};
+
+
+// Read-only view of a whole file. Memory mapped where supported, so
+// processes reading the same file share its pages in the page cache;
+// otherwise read into a private buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Returns false if the file cannot be opened or read.
+    bool open(const std::string& path);
+    void close();
+
+    std::string_view view() const { return {data, size}; }
+
+private:
+    const char* data = nullptr;
+    size_t size = 0;
+    bool mapped = false;
+    std::string buffer;
+};
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "csvparse.hpp"
+
+
+// Approximate query sketches.
+// Rows are grouped into blocks of consecutive times. Every block keeps a
+// t-digest (quantiles) and a HyperLogLog (distinct counts) per sketched column.
+// Both are mergeable, so a range query merges the sketches of the blocks it
+// covers and only scans the rows of the partially covered blocks at its edges.
+// Inserts update the sketches in place; deletions mark their block dirty and it
+// is rebuilt from its rows on the next checkpoint or compaction. Sketches are
+// persisted next to the main file as `<file>.sketch`.
+
+
+// Target number of rows per block. Blocks are split once they hold twice as many.
+constexpr long long SKETCH_BLOCK_POINTS = 16384;
+
+
+// Merging t-digest with the k1 scale function. Values are buffered and merged
+// into the centroids in batches.
+class TDigest {
+public:
+    struct Centroid {
+        double mean;
+        double weight;
+    };
+
+    explicit TDigest(double compression = 100.0);
+
+    void add(double value, double weight = 1.0);
+    void merge(const TDigest& other);
+
+    // Merges the buffered values into the centroids.
+    void compress();
+
+    // Estimated value at quantile `q` in [0, 1], NaN if empty.
+    double quantile(double q);
+
+    double count() const { return totalWeight; }
+    double min() const { return minValue; }
+    double max() const { return maxValue; }
+
+    // Centroids sorted by mean. Call compress() first to include buffered values.
+    const std::vector<Centroid>& centroids() const { return merged; }
+    void restore(double min, double max, std::vector<Centroid> centroids);
+
+private:
+    double compression;
+    std::vector<Centroid> merged;
+    std::vector<Centroid> buffer;
+    double totalWeight = 0.0;
+    double minValue = std::numeric_limits<double>::infinity();
+    double maxValue = -std::numeric_limits<double>::infinity();
+};
+
+
+// HyperLogLog with 2^PRECISION one-byte registers, about 1.6% standard error.
+class HyperLogLog {
+public:
+    static constexpr int PRECISION = 12;
+
+    HyperLogLog();
+
+    void add(uint64_t hash);
+    void merge(const HyperLogLog& other);
+    double estimate() const;
+
+    // Registers as hex digits, for persistence. fromHex returns false on malformed input.
+    std::string toHex() const;
+    bool fromHex(const std::string& hex);
+
+private:
+    std::vector<uint8_t> registers;
+};
+
+
+// 64-bit hash of a cell for distinct counting. Equal cells hash equal.
+uint64_t hashCell(const PointRow& cell);
+
+
+// Sketches of the rows with times in [startTime, next block's startTime).
+struct SketchBlock {
+    double startTime = -std::numeric_limits<double>::infinity();
+    long long points = 0;
+    double minTime = std::numeric_limits<double>::infinity();
+    double maxTime = -std::numeric_limits<double>::infinity();
+    bool dirty = false;                  // Sketches no longer match the rows
+    std::vector<TDigest> digests;        // One per sketch column, empty for non-numeric cells
+    std::vector<HyperLogLog> distinct;   // One per sketch column
+};
+
+
+// The sketched columns and their blocks, sorted by start time. The first
+// block starts at -infinity, so every time falls into exactly one block.
+struct Sketches {
+    std::vector<std::string> columns;
+    std::vector<int> columnIndices;  // Positions in Point::rows
+    std::vector<SketchBlock> blocks;
+    size_t persistedBlocks = 0;  // Blocks in the sidecar when it was last written
+};
+
+
+// Sketch construction and maintenance. An empty column list sketches every
+// column; unknown columns throw std::invalid_argument.
+Sketches makeSketches(const std::vector<std::string>& columns, const std::vector<std::string>& headers);
+size_t sketchBlockFor(const Sketches& sketches, double time);
+void sketchAdd(Sketches& sketches, const Point& point);
+void sketchRemove(Sketches& sketches, double time);
+
+// Builds the blocks for `points`, sorted by time, the first starting at
+// `startTime`. More than 2 * SKETCH_BLOCK_POINTS points are split into several
+// blocks. No points yield no blocks.
+std::vector<SketchBlock> buildSketchBlocks(const Sketches& sketches, double startTime,
+                                           const std::vector<const Point*>& points);
+
+// True if every row of a clean block lies in [startTime, endTime].
+bool sketchBlockCovered(const SketchBlock& block, double startTime, double endTime);
+
+// Sketch persistence ( Complete file rewritten ). Dirty blocks must be rebuilt
+// before writing. readSketches returns no columns if the file does not exist.
+// Rows appended after the last persisted one are added again on open, so the
+// file only needs rewriting when a block was opened or rebuilt.
+void writeSketches(const std::string& filename, Sketches& sketches);
+Sketches readSketches(const std::string& filename, const std::vector<std::string>& headers);
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "csvparse.hpp"
+#include "codec.hpp"
+#include "sharedaccess.hpp"
+
+
+// Persisted sparse index.
+// One entry per `stride` rows maps the time of a row to its byte offset in the
+// data file. It is written next to the data file as `<file>.idx` whenever the
+// file is checkpointed or compacted, and lets open skip the full index rebuild.
+// It doubles as the manifest for read-only openers: the data file is valid up
+// to `dataSize` as of `generation`, and `epoch` changes whenever the file is
+// replaced instead of appended to.
+
+
+// Rows between two entries of the sparse index.
+constexpr uint64_t SPARSE_INDEX_STRIDE = 4096;
+
+
+struct SparseIndexEntry {
+    double time;      // Time of the first row of the block
+    uint64_t offset;  // Byte offset of that row in the data file
+    uint64_t row;     // Row number, 0 is the first row after the header
+};
+
+
+struct SparseIndex {
+    uint64_t generation = 0;    // Bumped every time the index is rewritten
+    uint64_t epoch = 0;         // Kept across appends, new for every rewritten data file
+    uint64_t stride = SPARSE_INDEX_STRIDE;
+    uint64_t dataSize = 0;      // Size of the data file the index describes
+    uint64_t rowCount = 0;
+    uint64_t headerSize = 0;    // Bytes of the header line, including the newline
+    uint64_t dataChecksum = 0;  // FNV-1a of the header line and the last block
+    std::vector<SparseIndexEntry> entries;
+};
+
+
+// Scans the data file and builds its sparse index. With `previous`, the file
+// is assumed to have only grown since `previous` was built and scanning resumes
+// at its last block and the epoch is kept; without it the index gets a new
+// epoch. Throws if the file cannot be read or is not sorted by time.
+SparseIndex buildSparseIndex(const std::string& dataFilename, const SparseIndex* previous,
+                             uint64_t stride = SPARSE_INDEX_STRIDE);
+
+// Checks the index against the data file: size, checksum and entry layout.
+// Only reads the header line and the last block. With `allowGrowth` the file
+// may extend past `dataSize`, as it does while a writer appends to it.
+bool validateSparseIndex(const SparseIndex& index, const std::string& dataFilename, bool allowGrowth = false);
+bool validateSparseIndex(const SparseIndex& index, const MappedFile& data, bool allowGrowth = false);
+
+// Sidecar file I/O. readSparseIndex returns false if the file is missing or corrupt.
+void writeSparseIndex(const std::string& filename, const SparseIndex& index);
+bool readSparseIndex(const std::string& filename, SparseIndex& index);
+
+// Parses the data file block by block, in parallel, using the offsets of a
+// validated index. The full index is filled directly since the file is sorted.
+// Returns false, leaving `csv` and `dbIndex` untouched, if any block does not
+// match the index.
+bool parseCSVWithSparseIndex(const std::string& filename, const SparseIndex& index,
+                             const std::vector<ColumnType>& types, CSVData& csv,
+                             FullIndex& dbIndex, int threads);
+bool parseCSVWithSparseIndex(const MappedFile& data, const SparseIndex& index,
+                             const std::vector<ColumnType>& types, CSVData& csv,
+                             FullIndex& dbIndex, int threads);
+
+// Parses the rows `index` adds to `previous`, an older index of the same data
+// file, into `points`. `data` holds the file as validated against `index`.
+// Returns false if `index` does not extend `previous` or the rows do not match it.
+bool parseAppendedRows(const MappedFile& data, const SparseIndex& previous, const SparseIndex& index,
+                       const RowCodec& codec, size_t columns, std::vector<Point>& points);
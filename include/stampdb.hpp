@@ -2,15 +2,38 @@
 
 #include <string>
 #include <filesystem>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+#include <cmath>
 
 #include "internal/fileio.hpp"
 #include "internal/csvparse.hpp"
+#include "internal/codec.hpp"
+#include "internal/rollup.hpp"
+#include "internal/parallel.hpp"
+#include "internal/sparseindex.hpp"
+#include "internal/durability.hpp"
+#include "internal/resultcache.hpp"
+#include "internal/hotwindow.hpp"
+#include "internal/sketch.hpp"
+#include "internal/resample.hpp"
+#include "internal/sharedaccess.hpp"
+#include "internal/changefeed.hpp"
 
 class StampDB {
 public:
     // Constructor/Destructor
     explicit StampDB(const std::string& filename);
-    ~StampDB() = default;
+    // Schema column types ("string", "float", "int", "bool"), one per non-time column.
+    // A ReadWrite open takes the writer lock and throws std::runtime_error if
+    // another process has the file open for writing (see sharedaccess.hpp).
+    StampDB(const std::string& filename, const std::vector<std::string>& schema,
+            OpenMode mode = OpenMode::ReadWrite);
+    ~StampDB();
 
 
     // Disable copy/move for now
@@ -21,28 +44,234 @@ public:
 
 
     // CRUD Operations
-    CSVData read(double time);
-    CSVData read_range(double startTime, double endTime);
+    // `threads` of a query is the number of threads to use, 0 for all hardware
+    // threads, or USE_DB_THREADS (default) for the THREADS setting.
+    // `columns` projects the result onto the named columns (time is always
+    // included); empty reads all columns. Unknown names throw std::invalid_argument.
+    CSVData read(double time, const std::vector<std::string>& columns = {});
+    CSVData read_range(double startTime, double endTime, int threads = USE_DB_THREADS,
+                       const std::vector<std::string>& columns = {});
+
+    // Same as read/read_range, but fill a caller-owned result. Reusing the same
+    // CSVData across queries reuses its buffers instead of allocating new ones.
+    void read_into(double time, CSVData& result, const std::vector<std::string>& columns = {});
+    void read_range_into(double startTime, double endTime, CSVData& result,
+                         int threads = USE_DB_THREADS, const std::vector<std::string>& columns = {});
     CSVData delete_point(double time);
     bool appendPoint(const Point& point);
+    int appendPoints(std::vector<Point> points);
     bool updatePoint(const Point& point);
     
     
+    // Aggregations
+    RangeAggregate aggregate_range(double startTime, double endTime, const std::string& column,
+                                   int threads = USE_DB_THREADS);
+
+
+    // Result cache for read_range and aggregate_range, off by default.
+    // Entries are invalidated by any write inside their time range.
+    void setResultCache(size_t capacityBytes);
+    ResultCacheStats resultCacheStats() const;
+
+
+    // Hot window over the newest `points` points, only those within `seconds`
+    // of the newest one if `seconds` > 0. Reads and aggregates that start inside
+    // the window are answered from it without taking the database lock.
+    // 0 points disables it (default).
+    void setHotWindow(size_t points, double seconds = 0.0);
+    HotWindowStats hotWindowStats() const;
+
+
+    // Rollups (continuous aggregates)
+    bool addRollup(const RollupSpec& spec);
+    bool dropRollup(const std::string& name);
+    CSVData read_rollup(const std::string& name, double startTime, double endTime);
+    std::vector<RollupSpec> rollupSpecs() const;
+
+
+    // Approximate queries from per-block sketches (see sketch.hpp). An empty
+    // column list sketches every column. Returns false if exactly these columns
+    // are already sketched.
+    bool enableSketches(const std::vector<std::string>& columns = {});
+    bool dropSketches();
+    std::vector<std::string> sketchColumns() const;
+    // Estimated values at each quantile in [0, 1] of a numeric column over
+    // [startTime, endTime], NaN for an empty range.
+    std::vector<double> approxQuantiles(double startTime, double endTime, const std::string& column,
+                                        const std::vector<double>& quantiles);
+    // Estimated number of distinct values of a column over [startTime, endTime].
+    double approxDistinct(double startTime, double endTime, const std::string& column);
+
+
+    // Resampling onto the grid startTime, startTime + step, ... <= endTime (see
+    // resample.hpp). resampleColumns resolves `columns` to the columns written,
+    // every numeric column if empty; string columns throw std::invalid_argument.
+    std::vector<std::string> resampleColumns(const std::vector<std::string>& columns) const;
+    // Writes resampleSize(startTime, endTime, step) rows of the time and one
+    // double per resampled column into `out`.
+    void resample_into(double startTime, double endTime, double step, ResampleMethod method,
+                       const std::vector<std::string>& columns, double* out,
+                       int threads = USE_DB_THREADS);
+    
+
     // Database Management
     CSVData compact();
     bool checkpoint();
     void close();
 
 
+    // Shared access
+    // Read-only opens see the commits the writer published up to their last
+    // refresh. refresh() parses only the rows appended since; after a
+    // compaction or rewrite it reloads the file. Returns false if nothing
+    // changed, always for a ReadWrite open. Writes throw in read-only mode.
+    // While a writer has the file open, a read-only open or reload throws
+    // std::runtime_error if no published index matches the data file.
+    OpenMode openMode() const;
+    bool refresh();
+
+
+    // Durability
+    // Every append, update and delete gets the next sequence number. A sequence
+    // number is committed once the write is in the data file (fsynced unless the
+    // mode is None). Late points (at or before the newest time on disk, updates
+    // included) are merged by a sorted rewrite at the checkpoint; deletions are
+    // committed by the rewrite in compact(), EveryOpFsync, the background
+    // flusher and waitForCommit().
+    void setDurability(const DurabilityPolicy& policy);
+    DurabilityPolicy durability() const;
+    uint64_t lastSequence() const;
+    uint64_t committedSequence() const;
+    // Blocks until `sequence` is committed, asking the flusher to commit early.
+    // Without a flusher the commit runs on the calling thread. A negative timeout
+    // waits forever; returns false on timeout.
+    bool waitForCommit(uint64_t sequence, int timeoutMs = -1);
+
+
+    // Change feed (see changefeed.hpp)
+    // Delivers every append, update and delete after sequence `fromSeq` as it
+    // is applied, in sequence order. Starting before lastSequence() needs the
+    // events to be retained, LIVE_CHANGES starts from lastSequence(). Read-only
+    // opens deliver the rows each refresh() appends, numbered by their own
+    // sequence; a refresh that reloads the file disconnects every subscription
+    // as lagged, the reload itself taking one sequence number. Subscriptions
+    // are closed on close().
+    std::shared_ptr<ChangeSubscription> subscribe(uint64_t fromSeq = LIVE_CHANGES, size_t capacity = 4096,
+                                                  Backpressure backpressure = Backpressure::Block,
+                                                  int blockTimeoutMs = 1000);
+    // Keeps the last `events` events for subscriptions starting in the past, 0 by default.
+    void setChangeRetention(size_t events);
+
+
     // Configuration
-    int CHECKPOINT = 10;  // Number of operations before auto-compaction
+    int CHECKPOINT = 10;  // Operations between commits in DurabilityMode::OpCount
+    int MEMTABLE_CAPACITY = 4096;  // Late points buffered before merging into the index
+    int THREADS = 1;  // Threads per query, 0 uses all hardware threads
+    static constexpr int USE_DB_THREADS = -1;  // Per-query `threads` that defers to THREADS
+    IOOptions IO;  // Backend for checkpoint and compaction writes, `sync` follows the durability policy
 
 private:
+    // Loads the data file and its sidecars into the empty in-memory state.
+    void load();
+
+    // Throws std::runtime_error for read-only opens.
+    void requireWritable() const;
+
+    // Rewrites the complete file in time order and swaps it in.
+    void rewriteSorted();
+
+    // I/O options for data file writes.
+    IOOptions writeOptions() const;
+
+    // Commits all pending rows and deletions and advances committedSeq.
+    void commit();
+
+    // In-memory halves of the write operations, without committing.
+    // Each takes the next sequence number and publishes its change.
+    // removePoint returns false if there is no point at `time`, `publish` is
+    // false for the delete half of an update; insertPoint expects a new time
+    // and returns the approximate row size.
+    bool removePoint(double time, bool publish = true);
+    size_t insertPoint(const Point& point, ChangeKind kind);
+
+    // Called after every write operation, commits according to the policy.
+    void afterWrite(int operations, size_t bytes);
+
+    // Background flusher for the IntervalMs and Bytes modes.
+    void flusherLoop();
+    void stopFlusher();
+
+    // Resizes a result, recycling Points through pointPool.
+    void resizeResult(CSVData& result, size_t size);
+
+    // Worker count of a query for its `threads` argument.
+    int queryThreads(int threads) const;
+
+    // Positions in Point::rows of the columns resampled for `columns`.
+    std::vector<int> resamplePositions(const std::vector<std::string>& columns) const;
+
+    // Result headers and types, all columns if `projection` is nullptr.
+    void setResultColumns(CSVData& result, const std::vector<int>* projection) const;
+
+    // Rollup maintenance helpers.
+    Rollup* findRollup(const std::string& name);
+    void rebuildRollup(Rollup& rollup);
+    void persistRollups();
+    // Rescans the buckets in [startTime, endTime] whose min/max were invalidated by a deletion.
+    void rescanStaleBuckets(Rollup& rollup, double startTime, double endTime);
+
+    // Sketch maintenance helpers. refreshSketches rebuilds the dirty blocks from
+    // their rows; sketchRange merges the sketches of column `column` over a range.
+    // persistSketches skips the write if only the last block grew, unless `force`.
+    void refreshSketches();
+    void persistSketches(bool force);
+    void sketchRange(double startTime, double endTime, size_t column, TDigest* digest, HyperLogLog* distinct);
+    // Index into sketches.columns of a column name; throws std::invalid_argument if it is not sketched.
+    size_t sketchColumn(const std::string& column) const;
+
+    // Rewrites the sparse index sidecar after the data file changed.
+    // `appended` resumes from the current index instead of rescanning the file.
+    void persistSparseIndex(bool appended);
+
     std::string filename;
     std::string shadowFilename;
+    std::string rollupFilename;
+    std::string indexFilename;
+    std::string sketchFilename;
+    std::string lockFilename;
+    OpenMode mode;
+    WriterLock writerLock;  // Held by ReadWrite opens until close
+    std::vector<ColumnType> schemaTypes;  // Types given on open, empty to infer them
     CSVData data;
+    std::unique_ptr<RowCodec> codec;  // Row codec for data.types
     FullIndex dbIndex;  // std::vector<Index> sorted by time
+    MemTable memTable;  // Late arrivals, sorted by time, merged on checkpoint
     NewAdded newAdded;  // Tracks newly added indices
     DeletedIndices deletedIndices;  // Tracks deleted indices
+    std::vector<Rollup> rollups;  // Materialized rollups, persisted in rollupFilename
+    Sketches sketches;  // Approximate query sketches, persisted in sketchFilename, no columns when disabled
+    SparseIndex sparseIndex;  // Sparse index of the data file, persisted in indexFilename; the last manifest seen when read-only
+    bool hasSparseIndex = false;  // sparseIndex describes the current data file (read-only: the rows loaded)
+    ResultCache resultCache;  // Cached query results, 0 capacity when disabled
+    HotWindow hotWindow;      // Newest points for lock-free reads, disabled by default
+    ChangeFeed changeFeed;    // Change subscribers, idle without subscribers or retention
+    std::vector<Index> rangeScratch;  // Reused index slice for range queries
+    std::vector<Point> pointPool;  // Spare result Points that keep their row buffers
+    static constexpr size_t POINT_POOL_CAPACITY = 1 << 16;
     int operationCount;
+
+    // Durability state. `mutex` guards everything above; the flusher thread
+    // takes it for the duration of a commit.
+    mutable std::recursive_mutex mutex;
+    DurabilityPolicy policy;
+    uint64_t lastSeq = 0;  // Sequence number of the last write
+    uint64_t committedSeq = 0;  // Writes up to here are on disk
+    size_t pendingBytes = 0;  // Approximate size of rows not yet written
+    std::thread flusher;
+    bool flusherStop = false;
+    bool commitRequested = false;
+    std::exception_ptr flushError;  // Last failed background commit
+    std::condition_variable_any flushCondition;
+    std::condition_variable_any committedCondition;
+    double persistedMaxTime;  // Largest time written to disk, appends after it keep the file sorted
 };
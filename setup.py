@@ -1,6 +1,7 @@
 from setuptools import find_packages, setup, Extension
 import pybind11
 import os
+import sys
 import numpy as np
 
 if os.environ.get("READTHEDOCS") == "True":
@@ -8,6 +9,13 @@ if os.environ.get("READTHEDOCS") == "True":
 else:
     extra_compile_args=["/std:c++20"] if os.name == "nt" else ["-std=c++20"]
     
+# io_uring storage backend, opt-in: STAMPDB_WITH_IO_URING=1 pip install . (needs liburing)
+define_macros = []
+libraries = []
+if os.environ.get("STAMPDB_WITH_IO_URING") == "1" and sys.platform.startswith("linux"):
+    define_macros.append(("STAMPDB_WITH_IO_URING", "1"))
+    libraries.append("uring")
+
 
 extension = Extension(
     "stampdb._backend._types",
@@ -18,6 +26,19 @@ extension = Extension(
         "src/algorithms.cpp",
         "src/fileio.cpp",
         "src/stampdb.cpp",
+        "src/rollup.cpp",
+        "src/parallel.cpp",
+        "src/codec.cpp",
+        "src/sparseindex.cpp",
+        "src/iobackend.cpp",
+        "src/resultcache.cpp",
+        "src/faultinjection.cpp",
+        "src/hotwindow.cpp",
+        "src/sketch.cpp",
+        "src/resample.cpp",
+        "src/sharedaccess.cpp",
+        "src/arrow.cpp",
+        "src/changefeed.cpp",
     ],
     include_dirs=[
         "include",
@@ -30,6 +51,8 @@ extension = Extension(
     ],
     language="c++",
     extra_compile_args=extra_compile_args,
+    define_macros=define_macros,
+    libraries=libraries,
 )
 
 
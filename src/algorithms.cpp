@@ -1,5 +1,6 @@
 #include <vector>
 #include <algorithm>
+#include <iterator>
 
 #include "../include/internal/csvparse.hpp"
 
@@ -7,11 +8,17 @@
 // Insert an index while maintaining the FullIndex sorted by time
 void insertIndexSorted(FullIndex& fullIndex, const Index& newIndex) {
     auto& indices = fullIndex.indices;
-    auto it = std::lower_bound(indices.begin(), indices.end(), newIndex,
-        [](const Index& a, const Index& b) {
-            return a.time < b.time;
-        });
-    indices.insert(it, newIndex);
+
+    // Fast path: in-order rows (sorted files, live ingest) go to the back.
+    if (indices.empty() || indices.back().time <= newIndex.time) {
+        indices.push_back(newIndex);
+    } else {
+        auto it = std::upper_bound(indices.begin(), indices.end(), newIndex,
+            [](const Index& a, const Index& b) {
+                return a.time < b.time;
+            });
+        indices.insert(it, newIndex);
+    }
     
     // Update MAX_ROWNUM if needed
     if (newIndex.index > fullIndex.MAX_ROWNUM) {
@@ -51,3 +58,100 @@ std::vector<Index> findInTimeRange(const FullIndex& fullIndex,
 int getNextRowNumber(const FullIndex& fullIndex) {
     return fullIndex.MAX_ROWNUM + 1;
 }
+
+
+// Insert a late arrival into the MemTable, keeping it sorted by time.
+// The MemTable stays small, so this is cheap compared to shifting the FullIndex.
+void insertMemTable(MemTable& memTable, const Index& newIndex) {
+    auto& indices = memTable.indices;
+    auto it = std::upper_bound(indices.begin(), indices.end(), newIndex,
+        [](const Index& a, const Index& b) {
+            return a.time < b.time;
+        });
+    indices.insert(it, newIndex);
+}
+
+
+// Merge the MemTable into the FullIndex in a single pass and empty it.
+void mergeMemTable(FullIndex& fullIndex, MemTable& memTable) {
+    if (memTable.indices.empty()) {
+        return;
+    }
+
+    auto& indices = fullIndex.indices;
+    size_t middle = indices.size();
+    indices.insert(indices.end(), memTable.indices.begin(), memTable.indices.end());
+    std::inplace_merge(indices.begin(), indices.begin() + middle, indices.end(),
+        [](const Index& a, const Index& b) {
+            return a.time < b.time;
+        });
+
+    for (const auto& idx : memTable.indices) {
+        if (idx.index > fullIndex.MAX_ROWNUM) {
+            fullIndex.MAX_ROWNUM = idx.index;
+        }
+    }
+
+    memTable.indices.clear();
+}
+
+
+// Find all indices within [startTime, endTime] across the FullIndex and MemTable.
+// Results are returned sorted by time.
+std::vector<Index> findInTimeRange(const FullIndex& fullIndex, const MemTable& memTable,
+                                   double startTime, double endTime) {
+    std::vector<Index> out;
+    findInTimeRange(fullIndex, memTable, startTime, endTime, out);
+    return out;
+}
+
+
+// Same as above, but fills `out` so callers can reuse its capacity across queries.
+void findInTimeRange(const FullIndex& fullIndex, const MemTable& memTable,
+                     double startTime, double endTime, std::vector<Index>& out) {
+    out.clear();
+
+    const auto& indices = fullIndex.indices;
+    auto startIt = findFirstAfterOrEqualTime(fullIndex, startTime);
+    auto endIt = std::upper_bound(startIt, indices.end(), endTime,
+        [](double time, const Index& b) {
+            return time < b.time;
+        });
+
+    const auto& late = memTable.indices;
+    auto lateStartIt = std::lower_bound(late.begin(), late.end(), startTime,
+        [](const Index& a, double time) {
+            return a.time < time;
+        });
+    auto lateEndIt = std::upper_bound(lateStartIt, late.end(), endTime,
+        [](double time, const Index& b) {
+            return time < b.time;
+        });
+
+    out.reserve((endIt - startIt) + (lateEndIt - lateStartIt));
+    std::merge(startIt, endIt, lateStartIt, lateEndIt, std::back_inserter(out),
+        [](const Index& a, const Index& b) {
+            return a.time < b.time;
+        });
+}
+
+
+// Find the index of an exact time in the FullIndex or MemTable without allocating.
+// Returns nullptr if there is no point at that time.
+const Index* findExactTime(const FullIndex& fullIndex, const MemTable& memTable, double time) {
+    auto it = findFirstAfterOrEqualTime(fullIndex, time);
+    if (it != fullIndex.indices.end() && it->time == time) {
+        return &*it;
+    }
+
+    const auto& late = memTable.indices;
+    auto lateIt = std::lower_bound(late.begin(), late.end(), time,
+        [](const Index& a, double t) {
+            return a.time < t;
+        });
+    if (lateIt != late.end() && lateIt->time == time) {
+        return &*lateIt;
+    }
+
+    return nullptr;
+}
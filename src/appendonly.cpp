@@ -1,37 +1,41 @@
 #include "../include/internal/csvparse.hpp"
+#include "../include/internal/codec.hpp"
 
 // Actually append only DB Implementation.
-// This will be used along with a shadow copy.
-// The functions will be checkpointed after a few writes.
-// At this point a new Shadow copy will be created.
+// New rows are appended to the data file on checkpoint, in one sequential write.
+// Full rewrites (deletions, late points) go through the shadow copy instead.
 
-// Opens file in Append mode.
-std::ofstream openFileInAppend(const std::string& filename){
-    std::ofstream file(filename, std::ios::app);
-    return file;
+// Opens file in Append mode through the configured I/O backend.
+std::unique_ptr<FileWriter> openFileInAppend(const std::string& filename, const IOOptions& options) {
+    return openFileWriter(filename, true, options);
 }
 
 
 // Writes Newly added Points in Append mode.
+// Only the points of `csv` referenced by `newAdded` are written, in that order,
+// so callers do not have to copy them into a separate CSVData first.
 // Should be used in conjunction with `openFileInAppend`. 
-// File can be closed later.
-bool writeToCSV(const CSVData& csv, std::ofstream& file, NewAdded& newAdded) {    
-    if (!file.is_open()) {
-        return false;
+// File must be closed by the caller, which also reports write errors.
+bool writeToCSV(const CSVData& csv, FileWriter& file, NewAdded& newAdded) {    
+    if (newAdded.indices.empty()) {
+        return true;  // No rows to write is not an error
     }
 
-    std::vector<std::vector<std::string>> rows;
-    for (const auto& point : csv.points) {
-        rows.push_back(pointToVector(point));
+    auto codec = makeRowCodec(csv.types);
+    std::vector<std::string> row;
+    std::string line;
+    for (const auto& idx : newAdded.indices) {
+        if (idx.index < 0 || idx.index >= static_cast<int>(csv.points.size())) {
+            continue;
+        }
+        codec->serialize(csv.points[idx.index], row);
+        line.clear();
+        appendCSVRow(row, line);
+        if (!file.write(line)) {
+            return false;
+        }
     }
-
-    if (!rows.empty()) {
-        csv2::Writer<csv2::delimiter<','>> writer(file);
-        writer.write_rows(rows);
-        return file.good();
-    }
-    
-    return true;  // No rows to write is not an error
+    return true;
 }
 
 // For deletions we would have to periodically rewrite the complete file and replace atomically.
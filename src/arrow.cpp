@@ -0,0 +1,613 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include "../include/internal/arrow.hpp"
+#include "../include/internal/parallel.hpp"
+
+// Arrow C Data Interface export and import.
+// Every exported struct owns its private data and can be released on its own,
+// consumers may move children out of a parent. Exported arrays reference the
+// shared batch instead of copying its buffers.
+
+namespace {
+
+// Stands in for empty buffers, which must not be null for every consumer.
+alignas(8) const uint8_t kEmptyBuffer[8] = {};
+
+
+const char* formatOf(ColumnType type) {
+    switch (type) {
+        case ColumnType::Double:
+            return "g";
+        case ColumnType::Int:
+            return "i";
+        case ColumnType::Bool:
+            return "b";
+        case ColumnType::String:
+            return "u";
+    }
+    return "g";
+}
+
+
+ColumnType typeOfCell(const PointRow& cell) {
+    if (std::holds_alternative<int>(cell.data)) {
+        return ColumnType::Int;
+    } else if (std::holds_alternative<double>(cell.data)) {
+        return ColumnType::Double;
+    } else if (std::holds_alternative<bool>(cell.data)) {
+        return ColumnType::Bool;
+    }
+    return ColumnType::String;
+}
+
+
+// Header cells may carry the whitespace of the CSV file.
+std::string trimmed(const std::string& header) {
+    size_t first = header.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return "";
+    }
+    return header.substr(first, header.find_last_not_of(" \t\r\n") - first + 1);
+}
+
+
+// Export
+
+struct ExportedSchema {
+    std::string format;
+    std::string name;
+    std::vector<ArrowSchema> children;
+    std::vector<ArrowSchema*> childPointers;
+};
+
+
+struct ExportedArray {
+    std::shared_ptr<const ArrowBatch> batch;  // Owns the buffers
+    const void* buffers[3] = {nullptr, nullptr, nullptr};
+    std::vector<ArrowArray> children;
+    std::vector<ArrowArray*> childPointers;
+};
+
+
+struct ExportedStream {
+    std::shared_ptr<const ArrowBatch> batch;
+    bool done = false;
+};
+
+
+void releaseSchema(ArrowSchema* schema) {
+    if (schema == nullptr || schema->release == nullptr) {
+        return;
+    }
+    for (int64_t i = 0; i < schema->n_children; ++i) {
+        ArrowSchema* child = schema->children[i];
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+    }
+    delete static_cast<ExportedSchema*>(schema->private_data);
+    schema->release = nullptr;
+}
+
+
+void releaseArray(ArrowArray* array) {
+    if (array == nullptr || array->release == nullptr) {
+        return;
+    }
+    for (int64_t i = 0; i < array->n_children; ++i) {
+        ArrowArray* child = array->children[i];
+        if (child->release != nullptr) {
+            child->release(child);
+        }
+    }
+    delete static_cast<ExportedArray*>(array->private_data);
+    array->release = nullptr;
+}
+
+
+void fillSchema(ArrowSchema* out, ExportedSchema* owned, int64_t flags) {
+    out->format = owned->format.c_str();
+    out->name = owned->name.c_str();
+    out->metadata = nullptr;
+    out->flags = flags;
+    out->n_children = static_cast<int64_t>(owned->childPointers.size());
+    out->children = owned->childPointers.empty() ? nullptr : owned->childPointers.data();
+    out->dictionary = nullptr;
+    out->release = releaseSchema;
+    out->private_data = owned;
+}
+
+
+void fillArray(ArrowArray* out, ExportedArray* owned, int64_t length, int64_t nullCount, int64_t buffers) {
+    out->length = length;
+    out->null_count = nullCount;
+    out->offset = 0;
+    out->n_buffers = buffers;
+    out->n_children = static_cast<int64_t>(owned->childPointers.size());
+    out->buffers = owned->buffers;
+    out->children = owned->childPointers.empty() ? nullptr : owned->childPointers.data();
+    out->dictionary = nullptr;
+    out->release = releaseArray;
+    out->private_data = owned;
+}
+
+
+int streamGetSchema(ArrowArrayStream* stream, ArrowSchema* out) {
+    try {
+        exportArrowSchema(*static_cast<ExportedStream*>(stream->private_data)->batch, out);
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    return 0;
+}
+
+
+int streamGetNext(ArrowArrayStream* stream, ArrowArray* out) {
+    auto* owned = static_cast<ExportedStream*>(stream->private_data);
+    if (owned->done) {
+        out->release = nullptr;  // End of stream
+        return 0;
+    }
+    try {
+        exportArrowArray(owned->batch, out);
+    } catch (const std::bad_alloc&) {
+        return ENOMEM;
+    }
+    owned->done = true;
+    return 0;
+}
+
+
+const char* streamGetLastError(ArrowArrayStream*) {
+    return nullptr;
+}
+
+
+void releaseStream(ArrowArrayStream* stream) {
+    if (stream == nullptr || stream->release == nullptr) {
+        return;
+    }
+    delete static_cast<ExportedStream*>(stream->private_data);
+    stream->release = nullptr;
+}
+
+
+void setNull(ArrowColumn& column, size_t row, size_t length) {
+    if (column.validity.empty()) {
+        column.validity.assign((length + 7) / 8, 0xFF);
+    }
+    column.validity[row / 8] &= static_cast<uint8_t>(~(1u << (row % 8)));
+    column.nullCount++;
+}
+
+
+const PointRow* cellAt(const Point& point, int position) {
+    return position < static_cast<int>(point.rows.size()) ? &point.rows[position] : nullptr;
+}
+
+
+// Fills one column from the cells at `position`, the time if negative.
+void fillColumn(const std::vector<Point>& points, int position, ArrowColumn& column) {
+    size_t length = points.size();
+    if (position < 0) {
+        column.values.resize(length * sizeof(double));
+        double* out = reinterpret_cast<double*>(column.values.data());
+        for (size_t row = 0; row < length; ++row) {
+            out[row] = points[row].time;
+        }
+        return;
+    }
+
+    switch (column.type) {
+        case ColumnType::Double: {
+            column.values.resize(length * sizeof(double));
+            double* out = reinterpret_cast<double*>(column.values.data());
+            for (size_t row = 0; row < length; ++row) {
+                const PointRow* cell = cellAt(points[row], position);
+                if (cell == nullptr || !numericValue(*cell, out[row])) {
+                    out[row] = 0.0;
+                    setNull(column, row, length);
+                }
+            }
+            break;
+        }
+        case ColumnType::Int: {
+            column.values.resize(length * sizeof(int32_t));
+            int32_t* out = reinterpret_cast<int32_t*>(column.values.data());
+            for (size_t row = 0; row < length; ++row) {
+                const PointRow* cell = cellAt(points[row], position);
+                const int* value = cell != nullptr ? std::get_if<int>(&cell->data) : nullptr;
+                if (value != nullptr) {
+                    out[row] = *value;
+                } else {
+                    out[row] = 0;
+                    setNull(column, row, length);
+                }
+            }
+            break;
+        }
+        case ColumnType::Bool: {
+            column.values.assign((length + 7) / 8, 0);
+            for (size_t row = 0; row < length; ++row) {
+                const PointRow* cell = cellAt(points[row], position);
+                const bool* value = cell != nullptr ? std::get_if<bool>(&cell->data) : nullptr;
+                if (value == nullptr) {
+                    setNull(column, row, length);
+                } else if (*value) {
+                    column.values[row / 8] |= static_cast<uint8_t>(1u << (row % 8));
+                }
+            }
+            break;
+        }
+        case ColumnType::String: {
+            column.offsets.reserve(length + 1);
+            column.offsets.push_back(0);
+            for (size_t row = 0; row < length; ++row) {
+                const PointRow* cell = cellAt(points[row], position);
+                const std::string* value = cell != nullptr ? std::get_if<std::string>(&cell->data) : nullptr;
+                if (value == nullptr) {
+                    setNull(column, row, length);
+                } else {
+                    column.chars += *value;
+                }
+                if (column.chars.size() > static_cast<size_t>(std::numeric_limits<int32_t>::max())) {
+                    throw std::runtime_error("Column " + column.name + " exceeds 2 GiB of string data");
+                }
+                column.offsets.push_back(static_cast<int32_t>(column.chars.size()));
+            }
+            break;
+        }
+    }
+}
+
+
+// Import
+
+enum class ArrowKind {
+    Float,
+    Integer,
+    Bool,
+    String,
+    LargeString,
+    Timestamp,
+    Unsupported
+};
+
+
+// A child of the imported struct array, its rows shifted by both offsets.
+struct ImportedColumn {
+    std::string name;
+    std::string format;
+    ArrowKind kind = ArrowKind::Unsupported;
+    double scale = 1.0;  // Seconds per unit of a timestamp
+    const ArrowArray* array = nullptr;
+    int64_t offset = 0;
+};
+
+
+ArrowKind kindOf(const std::string& format, double& scale) {
+    if (format == "g" || format == "f") {
+        return ArrowKind::Float;
+    }
+    if (format.size() == 1 && std::strchr("lisc" "LISC", format[0]) != nullptr) {
+        return ArrowKind::Integer;
+    }
+    if (format == "b") {
+        return ArrowKind::Bool;
+    }
+    if (format == "u") {
+        return ArrowKind::String;
+    }
+    if (format == "U") {
+        return ArrowKind::LargeString;
+    }
+    // Timestamps: "ts" + unit + ":" + timezone, always relative to the UTC epoch
+    if (format.size() >= 4 && format.compare(0, 2, "ts") == 0 && format[3] == ':') {
+        switch (format[2]) {
+            case 's': scale = 1.0; return ArrowKind::Timestamp;
+            case 'm': scale = 1e-3; return ArrowKind::Timestamp;
+            case 'u': scale = 1e-6; return ArrowKind::Timestamp;
+            case 'n': scale = 1e-9; return ArrowKind::Timestamp;
+        }
+    }
+    return ArrowKind::Unsupported;
+}
+
+
+bool isNull(const ImportedColumn& column, int64_t row) {
+    const auto* bits = static_cast<const uint8_t*>(column.array->buffers[0]);
+    if (column.array->null_count == 0 || bits == nullptr) {
+        return false;
+    }
+    int64_t bit = column.offset + row;
+    return (bits[bit / 8] & (1u << (bit % 8))) == 0;
+}
+
+
+template <typename T>
+T valueAt(const ImportedColumn& column, int64_t row) {
+    T value;
+    std::memcpy(&value, static_cast<const uint8_t*>(column.array->buffers[1]) + (column.offset + row) * sizeof(T), sizeof(T));
+    return value;
+}
+
+
+int64_t integerAt(const ImportedColumn& column, int64_t row) {
+    switch (column.format[0]) {
+        case 'l': return valueAt<int64_t>(column, row);
+        case 'i': return valueAt<int32_t>(column, row);
+        case 's': return valueAt<int16_t>(column, row);
+        case 'c': return valueAt<int8_t>(column, row);
+        case 'L': {
+            uint64_t value = valueAt<uint64_t>(column, row);
+            return value > static_cast<uint64_t>(std::numeric_limits<int64_t>::max())
+                ? std::numeric_limits<int64_t>::max() : static_cast<int64_t>(value);
+        }
+        case 'I': return valueAt<uint32_t>(column, row);
+        case 'S': return valueAt<uint16_t>(column, row);
+        case 'C': return valueAt<uint8_t>(column, row);
+    }
+    return 0;
+}
+
+
+double numberAt(const ImportedColumn& column, int64_t row) {
+    switch (column.kind) {
+        case ArrowKind::Float:
+            return column.format == "g" ? valueAt<double>(column, row) : valueAt<float>(column, row);
+        case ArrowKind::Timestamp:
+            return static_cast<double>(valueAt<int64_t>(column, row)) * column.scale;
+        default:
+            return static_cast<double>(integerAt(column, row));
+    }
+}
+
+
+bool boolAt(const ImportedColumn& column, int64_t row) {
+    int64_t bit = column.offset + row;
+    return (static_cast<const uint8_t*>(column.array->buffers[1])[bit / 8] & (1u << (bit % 8))) != 0;
+}
+
+
+std::string stringAt(const ImportedColumn& column, int64_t row) {
+    const char* chars = static_cast<const char*>(column.array->buffers[2]);
+    int64_t begin;
+    int64_t end;
+    if (column.kind == ArrowKind::LargeString) {
+        begin = valueAt<int64_t>(column, row);
+        end = valueAt<int64_t>(column, row + 1);
+    } else {
+        begin = valueAt<int32_t>(column, row);
+        end = valueAt<int32_t>(column, row + 1);
+    }
+    return std::string(chars + begin, static_cast<size_t>(end - begin));
+}
+
+
+bool convertible(ArrowKind kind, ColumnType type) {
+    switch (type) {
+        case ColumnType::Double:
+            return kind == ArrowKind::Float || kind == ArrowKind::Integer || kind == ArrowKind::Timestamp;
+        case ColumnType::Int:
+            return kind == ArrowKind::Integer;
+        case ColumnType::Bool:
+            return kind == ArrowKind::Bool;
+        case ColumnType::String:
+            return kind == ArrowKind::String || kind == ArrowKind::LargeString;
+    }
+    return false;
+}
+
+}  // namespace
+
+
+ArrowBatch makeArrowBatch(const CSVData& data, int threads) {
+    const auto& points = data.points;
+    if (data.headers.empty()) {
+        throw std::runtime_error("Result has no columns");
+    }
+
+    // Untyped results take their types from the first row; without rows every
+    // column is exported as a string.
+    std::vector<ColumnType> types = data.types;
+    if (types.size() + 1 != data.headers.size()) {
+        types.assign(data.headers.size() - 1, ColumnType::String);
+        for (size_t i = 0; !points.empty() && i < types.size() && i < points[0].rows.size(); ++i) {
+            types[i] = typeOfCell(points[0].rows[i]);
+        }
+    }
+
+    ArrowBatch batch;
+    batch.length = static_cast<int64_t>(points.size());
+    batch.columns.resize(data.headers.size());
+    for (size_t i = 0; i < batch.columns.size(); ++i) {
+        batch.columns[i].name = trimmed(data.headers[i]);
+        batch.columns[i].type = i == 0 ? ColumnType::Double : types[i - 1];
+        batch.columns[i].nullable = i > 0;
+    }
+
+    parallelForMorsels(batch.columns.size(), resolveThreadCount(threads), 1,
+        [&](size_t first, size_t last, int) {
+            for (size_t i = first; i < last; ++i) {
+                fillColumn(points, static_cast<int>(i) - 1, batch.columns[i]);
+            }
+        });
+    return batch;
+}
+
+
+void exportArrowSchema(const ArrowBatch& batch, ArrowSchema* out) {
+    auto* root = new ExportedSchema{"+s", "", {}, {}};
+    root->children.resize(batch.columns.size());
+    for (size_t i = 0; i < batch.columns.size(); ++i) {
+        const ArrowColumn& column = batch.columns[i];
+        auto* child = new ExportedSchema{formatOf(column.type), column.name, {}, {}};
+        fillSchema(&root->children[i], child, column.nullable ? ARROW_FLAG_NULLABLE : 0);
+        root->childPointers.push_back(&root->children[i]);
+    }
+    fillSchema(out, root, 0);
+}
+
+
+void exportArrowArray(const std::shared_ptr<const ArrowBatch>& batch, ArrowArray* out) {
+    auto* root = new ExportedArray{batch, {nullptr, nullptr, nullptr}, {}, {}};
+    root->children.resize(batch->columns.size());
+    for (size_t i = 0; i < batch->columns.size(); ++i) {
+        const ArrowColumn& column = batch->columns[i];
+        auto* child = new ExportedArray{batch, {nullptr, nullptr, nullptr}, {}, {}};
+        child->buffers[0] = column.nullCount > 0 ? column.validity.data() : nullptr;
+        int64_t buffers = 2;
+        if (column.type == ColumnType::String) {
+            child->buffers[1] = column.offsets.data();
+            child->buffers[2] = column.chars.empty() ? kEmptyBuffer : static_cast<const void*>(column.chars.data());
+            buffers = 3;
+        } else {
+            child->buffers[1] = column.values.empty() ? kEmptyBuffer : column.values.data();
+        }
+        fillArray(&root->children[i], child, batch->length, column.nullCount, buffers);
+        root->childPointers.push_back(&root->children[i]);
+    }
+    fillArray(out, root, batch->length, 0, 1);
+}
+
+
+void exportArrowStream(const std::shared_ptr<const ArrowBatch>& batch, ArrowArrayStream* out) {
+    out->get_schema = streamGetSchema;
+    out->get_next = streamGetNext;
+    out->get_last_error = streamGetLastError;
+    out->release = releaseStream;
+    out->private_data = new ExportedStream{batch, false};
+}
+
+
+std::vector<Point> importArrowArray(const ArrowSchema& schema, const ArrowArray& array,
+                                    const std::vector<std::string>& headers,
+                                    const std::vector<ColumnType>& types) {
+    if (std::string(schema.format) != "+s" || schema.n_children != array.n_children) {
+        throw std::invalid_argument("Arrow data must be a record batch (struct array)");
+    }
+    if (array.null_count > 0) {
+        throw std::invalid_argument("Arrow record batch has null rows");
+    }
+    if (headers.empty() || (!types.empty() && types.size() + 1 != headers.size())) {
+        throw std::invalid_argument("Schema does not match the headers");
+    }
+
+    std::vector<ImportedColumn> columns(headers.size());
+    std::vector<bool> found(headers.size(), false);
+    for (int64_t c = 0; c < schema.n_children; ++c) {
+        const ArrowSchema* field = schema.children[c];
+        std::string name = field->name != nullptr ? field->name : "";
+        auto header = std::find(headers.begin(), headers.end(), name);
+        size_t slot = static_cast<size_t>(header - headers.begin());
+        if (header == headers.end() || found[slot]) {
+            throw std::invalid_argument("Arrow column is not in the schema: " + name);
+        }
+        if (field->dictionary != nullptr) {
+            throw std::invalid_argument("Dictionary-encoded Arrow columns are not supported: " + name);
+        }
+
+        ImportedColumn& column = columns[slot];
+        column.name = name;
+        column.format = field->format;
+        column.kind = kindOf(column.format, column.scale);
+        column.array = array.children[c];
+        column.offset = array.offset + column.array->offset;
+        found[slot] = true;
+
+        if (column.kind == ArrowKind::Unsupported) {
+            throw std::invalid_argument("Unsupported Arrow type '" + column.format + "' of column " + name);
+        }
+        if (column.array->length < array.offset + array.length) {
+            throw std::invalid_argument("Arrow column is shorter than its record batch: " + name);
+        }
+    }
+    for (size_t i = 0; i < headers.size(); ++i) {
+        if (!found[i]) {
+            throw std::invalid_argument("Arrow data has no column " + headers[i]);
+        }
+    }
+
+    // Target types, from the Arrow types for an untyped database
+    std::vector<ColumnType> targets = types;
+    if (targets.empty()) {
+        for (size_t i = 1; i < columns.size(); ++i) {
+            switch (columns[i].kind) {
+                case ArrowKind::Float:
+                case ArrowKind::Timestamp:
+                    targets.push_back(ColumnType::Double);
+                    break;
+                case ArrowKind::Integer:
+                    targets.push_back(ColumnType::Int);
+                    break;
+                case ArrowKind::Bool:
+                    targets.push_back(ColumnType::Bool);
+                    break;
+                default:
+                    targets.push_back(ColumnType::String);
+                    break;
+            }
+        }
+    }
+
+    const ImportedColumn& time = columns[0];
+    if (time.kind != ArrowKind::Float && time.kind != ArrowKind::Integer && time.kind != ArrowKind::Timestamp) {
+        throw std::invalid_argument("Time column must be numeric or a timestamp");
+    }
+    for (size_t i = 1; i < columns.size(); ++i) {
+        if (!convertible(columns[i].kind, targets[i - 1])) {
+            throw std::invalid_argument("Arrow type '" + columns[i].format + "' does not match the type of column " +
+                                        columns[i].name);
+        }
+    }
+
+    int64_t length = array.length;
+    std::vector<Point> points(static_cast<size_t>(length));
+    for (int64_t row = 0; row < length; ++row) {
+        if (isNull(time, row)) {
+            throw std::invalid_argument("Time column has nulls");
+        }
+        points[row].time = numberAt(time, row);
+        points[row].rows.resize(columns.size() - 1);
+    }
+
+    // One column at a time, with one type dispatch per column
+    for (size_t i = 1; i < columns.size(); ++i) {
+        const ImportedColumn& column = columns[i];
+        ColumnType target = targets[i - 1];
+        for (int64_t row = 0; row < length; ++row) {
+            PointRow& cell = points[row].rows[i - 1];
+            if (isNull(column, row)) {
+                if (target != ColumnType::Double) {
+                    throw std::invalid_argument("Column " + column.name + " has nulls");
+                }
+                cell.data = std::numeric_limits<double>::quiet_NaN();
+                continue;
+            }
+            switch (target) {
+                case ColumnType::Double:
+                    cell.data = numberAt(column, row);
+                    break;
+                case ColumnType::Int: {
+                    int64_t value = integerAt(column, row);
+                    if (value < std::numeric_limits<int32_t>::min() || value > std::numeric_limits<int32_t>::max()) {
+                        throw std::invalid_argument("Column " + column.name + " does not fit in 32 bit integers");
+                    }
+                    cell.data = static_cast<int>(value);
+                    break;
+                }
+                case ColumnType::Bool:
+                    cell.data = boolAt(column, row);
+                    break;
+                case ColumnType::String:
+                    cell.data = stringAt(column, row);
+                    break;
+            }
+        }
+    }
+    return points;
+}
@@ -0,0 +1,262 @@
+#include "../include/internal/changefeed.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+
+// Change feed.
+// The queue itself is lock-free; the mutex and condition variables only put
+// an idle side to sleep. A side announces that it sleeps with a flag, then
+// rechecks the queue; the other side checks the flag after its queue
+// operation. With a full fence between the store and the load on both sides
+// at least one of them sees the other, so no wake-up is lost, and a side
+// that is not sleeping costs the other one a fence and a load.
+
+
+ChangeSubscription::ChangeSubscription(size_t capacity, Backpressure backpressure, int blockTimeoutMs)
+    : queue(capacity), backpressure(backpressure), blockTimeoutMs(blockTimeoutMs) {}
+
+size_t ChangeSubscription::poll(std::vector<ChangeEvent>& out, size_t maxEvents, int timeoutMs) {
+    auto drain = [&]() {
+        size_t count = 0;
+        ChangeEvent event;
+        while (count < maxEvents && queue.tryPop(event)) {
+            polledSeq.store(event.seq);
+            out.push_back(std::move(event));
+            count++;
+        }
+        if (count > 0) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (producerWaiting.load()) {
+                std::lock_guard<std::mutex> lock(wakeMutex);
+                producerWake.notify_one();
+            }
+        }
+        return count;
+    };
+
+    size_t count = drain();
+    if (count > 0 || timeoutMs == 0 || maxEvents == 0) {
+        return count;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        consumerWaiting.store(true);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        auto ready = [&]() { return queue.size() > 0 || isClosed.load(); };
+        if (timeoutMs < 0) {
+            consumerWake.wait(lock, ready);
+        } else {
+            consumerWake.wait_for(lock, std::chrono::milliseconds(timeoutMs), ready);
+        }
+        consumerWaiting.store(false);
+    }
+    return drain();
+}
+
+void ChangeSubscription::close() {
+    isClosed.store(true);
+    std::lock_guard<std::mutex> lock(wakeMutex);
+    consumerWake.notify_all();
+    producerWake.notify_all();
+}
+
+void ChangeSubscription::disconnect() {
+    isLagged.store(true);
+    close();
+}
+
+bool ChangeSubscription::offer(const ChangeEvent& event) {
+    if (isClosed.load()) {
+        return false;
+    }
+
+    bool pushed = queue.tryPush(event);
+    if (!pushed) {
+        if (backpressure == Backpressure::Disconnect) {
+            disconnect();
+            return false;
+        }
+
+        // Wait for the consumer to make room
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(blockTimeoutMs, 0));
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        producerWaiting.store(true);
+        while (true) {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (isClosed.load()) {
+                break;
+            }
+            if (queue.tryPush(event)) {
+                pushed = true;
+                break;
+            }
+            if (blockTimeoutMs < 0) {
+                producerWake.wait(lock);
+            } else if (producerWake.wait_until(lock, deadline) == std::cv_status::timeout) {
+                pushed = queue.tryPush(event);
+                break;
+            }
+        }
+        producerWaiting.store(false);
+        lock.unlock();
+
+        if (!pushed) {
+            if (!isClosed.load()) {
+                disconnect();
+            }
+            return false;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (consumerWaiting.load()) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        consumerWake.notify_one();
+    }
+    return true;
+}
+
+
+ChangeFeed::~ChangeFeed() {
+    closeAll();
+}
+
+void ChangeFeed::setRetention(size_t events, uint64_t lastSeq) {
+    retainCapacity = events;
+    while (retained.size() > retainCapacity) {
+        retainedAfter = retained.front().seq;
+        retained.pop_front();
+    }
+    if (retained.empty()) {
+        retainedAfter = lastSeq;
+    }
+}
+
+std::shared_ptr<ChangeSubscription> ChangeFeed::subscribe(uint64_t fromSeq, uint64_t lastSeq, size_t capacity,
+                                                          Backpressure backpressure, int blockTimeoutMs) {
+    if (capacity == 0) {
+        throw std::invalid_argument("Subscription capacity must be positive");
+    }
+    if (fromSeq == LIVE_CHANGES) {
+        fromSeq = lastSeq;
+    }
+    if (fromSeq > lastSeq) {
+        throw std::invalid_argument("Cannot subscribe from sequence " + std::to_string(fromSeq) +
+                                    ", the last sequence is " + std::to_string(lastSeq));
+    }
+    if (fromSeq < lastSeq && (retainCapacity == 0 || fromSeq < retainedAfter)) {
+        throw std::invalid_argument("Changes after sequence " + std::to_string(fromSeq) +
+                                    " are no longer retained");
+    }
+
+    // Retained events the subscriber has not seen, queued ahead of live ones.
+    // Events still waiting for delivery are retained too and skipped later.
+    auto backlog = std::upper_bound(retained.begin(), retained.end(), fromSeq,
+        [](uint64_t seq, const ChangeEvent& event) { return seq < event.seq; });
+    size_t replay = static_cast<size_t>(std::distance(backlog, retained.end()));
+
+    auto subscription = std::make_shared<ChangeSubscription>(capacity + replay, backpressure, blockTimeoutMs);
+    subscription->polledSeq.store(fromSeq);
+    subscription->queuedSeq = lastSeq;
+    for (auto it = backlog; it != retained.end(); ++it) {
+        subscription->queue.tryPush(*it);
+    }
+
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    subscribers.push_back(subscription);
+    subscriberCount.store(subscribers.size());
+    return subscription;
+}
+
+void ChangeFeed::publish(ChangeKind kind, uint64_t seq, const Point& point) {
+    ChangeEvent event{seq, kind, point};
+
+    if (retainCapacity > 0) {
+        retained.push_back(event);
+        if (retained.size() > retainCapacity) {
+            retainedAfter = retained.front().seq;
+            retained.pop_front();
+        }
+    }
+
+    if (subscriberCount.load() > 0) {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        pending.push_back(std::move(event));
+    }
+}
+
+void ChangeFeed::deliver() {
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        if (pending.empty()) {
+            return;
+        }
+    }
+
+    std::lock_guard<std::mutex> delivering(deliveryMutex);
+    std::vector<ChangeEvent> events;
+    std::vector<std::shared_ptr<ChangeSubscription>> targets;
+    while (true) {
+        {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            if (pending.empty()) {
+                return;
+            }
+            events.swap(pending);
+            targets = subscribers;
+        }
+
+        // Closed and lagged subscriptions are dropped
+        std::vector<ChangeSubscription*> dropped;
+        for (const auto& subscription : targets) {
+            for (const auto& event : events) {
+                if (event.seq <= subscription->queuedSeq) {
+                    continue;
+                }
+                if (!subscription->offer(event)) {
+                    dropped.push_back(subscription.get());
+                    break;
+                }
+                subscription->queuedSeq = event.seq;
+            }
+        }
+        events.clear();
+
+        if (!dropped.empty()) {
+            std::lock_guard<std::mutex> lock(pendingMutex);
+            subscribers.erase(std::remove_if(subscribers.begin(), subscribers.end(),
+                [&](const std::shared_ptr<ChangeSubscription>& subscription) {
+                    return std::find(dropped.begin(), dropped.end(), subscription.get()) != dropped.end();
+                }), subscribers.end());
+            subscriberCount.store(subscribers.size());
+        }
+    }
+}
+
+void ChangeFeed::closeAll() {
+    closeSubscribers(false);
+}
+
+void ChangeFeed::disconnectAll(uint64_t lastSeq) {
+    closeSubscribers(true);
+    retained.clear();
+    retainedAfter = lastSeq;
+}
+
+void ChangeFeed::closeSubscribers(bool lagged) {
+    // Closing also wakes a deliverer waiting for one of them
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    for (auto& subscription : subscribers) {
+        if (lagged) {
+            subscription->disconnect();
+        } else {
+            subscription->close();
+        }
+    }
+    subscribers.clear();
+    subscriberCount.store(0);
+    pending.clear();
+}
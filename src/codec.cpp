@@ -0,0 +1,156 @@
+#include <functional>
+#include <map>
+
+#include "../include/internal/codec.hpp"
+
+// Row codec registry and the runtime (generic) codec.
+
+
+ColumnType columnTypeFromName(const std::string& name) {
+    if (name == "float" || name == "double") {
+        return ColumnType::Double;
+    } else if (name == "int") {
+        return ColumnType::Int;
+    } else if (name == "bool") {
+        return ColumnType::Bool;
+    } else if (name == "string") {
+        return ColumnType::String;
+    }
+    throw std::invalid_argument("Invalid column type: " + name);
+}
+
+
+std::vector<ColumnType> inferColumnTypes(const std::vector<std::string>& cells) {
+    std::vector<ColumnType> types;
+    types.reserve(cells.size());
+    for (const auto& cell : cells) {
+        PointRow row = parseCellGeneric(cell);
+        if (std::holds_alternative<bool>(row.data)) {
+            types.push_back(ColumnType::Bool);
+        } else if (std::holds_alternative<double>(row.data)) {
+            types.push_back(ColumnType::Double);
+        } else if (std::holds_alternative<int>(row.data)) {
+            types.push_back(ColumnType::Int);
+        } else {
+            types.push_back(ColumnType::String);
+        }
+    }
+    return types;
+}
+
+
+DynamicRowCodec::DynamicRowCodec(const std::vector<ColumnType>& types) {
+    columnTypes = types;
+}
+
+
+void DynamicRowCodec::parse(const std::vector<std::string>& cells, Point& point) const {
+    codec::parseTime(cells, point);
+    point.rows.resize(cells.size() - 1);
+    for (size_t i = 0; i < point.rows.size(); ++i) {
+        const std::string& text = cells[i + 1];
+        PointRow& row = point.rows[i];
+
+        if (i >= columnTypes.size()) {
+            row = parseCellGeneric(text);
+            continue;
+        }
+
+        bool parsed = false;
+        switch (columnTypes[i]) {
+            case ColumnType::Double: {
+                double value;
+                if ((parsed = codec::parseCell(text, value))) row.data = value;
+                break;
+            }
+            case ColumnType::Int: {
+                int value;
+                if ((parsed = codec::parseCell(text, value))) row.data = value;
+                break;
+            }
+            case ColumnType::Bool: {
+                bool value;
+                if ((parsed = codec::parseCell(text, value))) row.data = value;
+                break;
+            }
+            case ColumnType::String:
+                row.data = text;
+                parsed = true;
+                break;
+        }
+
+        if (!parsed) {
+            row = parseCellGeneric(text);
+        }
+    }
+}
+
+
+void DynamicRowCodec::serialize(const Point& point, std::vector<std::string>& out) const {
+    out.resize(point.rows.size() + 1);
+    codec::formatTime(point.time, out[0]);
+    for (size_t i = 0; i < point.rows.size(); ++i) {
+        std::string& cell = out[i + 1];
+        std::visit([&cell](const auto& value) { codec::formatCell(value, cell); }, point.rows[i].data);
+    }
+}
+
+
+void DynamicRowCodec::coerce(Point& point) const {
+    if (columnTypes.empty()) {
+        return;  // Untyped, keep cells as they are
+    }
+    if (point.rows.size() != columnTypes.size()) {
+        throw std::invalid_argument("Point does not match the number of schema columns");
+    }
+
+    for (size_t i = 0; i < columnTypes.size(); ++i) {
+        switch (columnTypes[i]) {
+            case ColumnType::Double: codec::coerceCell<double>(point.rows[i]); break;
+            case ColumnType::Int: codec::coerceCell<int>(point.rows[i]); break;
+            case ColumnType::Bool: codec::coerceCell<bool>(point.rows[i]); break;
+            case ColumnType::String: codec::coerceCell<std::string>(point.rows[i]); break;
+        }
+    }
+}
+
+
+namespace {
+
+template <typename... Ts>
+std::pair<std::vector<ColumnType>, std::function<std::unique_ptr<RowCodec>()>> entry() {
+    return {{codec::columnTypeOf<Ts>()...}, [] { return std::make_unique<TypedRowCodec<Ts...>>(); }};
+}
+
+// Layouts that get a compile-time codec. Extend this list for other hot schemas.
+const std::map<std::vector<ColumnType>, std::function<std::unique_ptr<RowCodec>()>>& typedCodecs() {
+    using S = std::string;
+    static const std::map<std::vector<ColumnType>, std::function<std::unique_ptr<RowCodec>()>> registry = {
+        entry<double>(),
+        entry<double, double>(),
+        entry<double, double, double>(),
+        entry<double, double, double, double>(),
+        entry<int>(),
+        entry<double, int>(),
+        entry<int, double>(),
+        entry<double, bool>(),
+        entry<double, S>(),
+        entry<S, double>(),
+        entry<double, double, S>(),
+        entry<double, S, bool>(),
+        entry<double, double, int, bool>(),
+    };
+    return registry;
+}
+
+}  // namespace
+
+
+std::unique_ptr<RowCodec> makeRowCodec(const std::vector<ColumnType>& types) {
+    const auto& registry = typedCodecs();
+    auto it = registry.find(types);
+    if (it != registry.end()) {
+        return it->second();
+    }
+    return std::make_unique<DynamicRowCodec>(types);
+}
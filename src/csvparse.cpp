@@ -1,4 +1,8 @@
+#include <cstdio>
+#include <stdexcept>
+
 #include "../include/internal/csvparse.hpp"
+#include "../include/internal/codec.hpp"
 
 
 bool __parse_bool(const std::string& value);
@@ -7,8 +11,9 @@ bool __parse_bool(const std::string& value);
 // All functions here work on complete CSV files.
 // Entire CSV Files are loaded and entire CSV Files are written.
 
-CSVData parseCSV(const std::string& filename, FullIndex& dbIndex) {
+CSVData parseCSV(const std::string& filename, FullIndex& dbIndex, const std::vector<ColumnType>& types) {
     CSVData csv;
+    csv.types = types;
 
     csv2::Reader<csv2::delimiter<','>,
                  csv2::quote_character<'"'>,
@@ -23,10 +28,25 @@ CSVData parseCSV(const std::string& filename, FullIndex& dbIndex) {
             csv.headers.push_back(value);
         }
 
+        if (!types.empty() && types.size() + 1 != csv.headers.size()) {
+            throw std::invalid_argument("Schema does not match the number of columns in " + filename);
+        }
+
+        // Built from the schema, or from the first row when there is none.
+        std::unique_ptr<RowCodec> codec;
+        if (!types.empty()) {
+            codec = makeRowCodec(types);
+        }
+
         int iter = 0;
 
         // returns `size_t` number of rows.
         dbIndex.MAX_ROWNUM = (int)reader.rows();
+        csv.points.reserve(reader.rows());
+        dbIndex.indices.reserve(reader.rows());
+
+        // Cell buffer reused across rows
+        std::vector<std::string> cells;
 
         // rows
         for (const auto& row : reader) {
@@ -37,68 +57,25 @@ CSVData parseCSV(const std::string& filename, FullIndex& dbIndex) {
                 continue;
             }        
 
+            readRowCells(row, cells);
+
+            if (!codec) {
+                codec = makeRowCodec(inferColumnTypes({cells.begin() + 1, cells.end()}));
+                csv.types = codec->types();
+            }
+
             Point point;
-            bool first = true;
+            codec->parse(cells, point);
 
             Index thisIndex;
             thisIndex.index = iter;
+            thisIndex.time = point.time;
             iter++;
 
-            bool is_last_cell = false;
-            size_t cell_count = 0;
-            size_t total_cells = csv.headers.size();
-            
-            for (const auto& cell : row) {
-                std::string value;
-                cell.read_value(value);
-                
-                cell_count++;
-                is_last_cell = (cell_count == total_cells);
-
-                #ifdef _WIN32
-                    // Remove trailing '\r' only from the last cell on Windows
-                    if (is_last_cell && !value.empty() && value.back() == '\r') {
-                        value.pop_back();
-                    }
-                #endif
-
-                if (first) {
-                    // treat first col as time
-                    point.time = std::stod(value);
-                    first = false;
-
-                    thisIndex.time = point.time;
-
-                    // Insert the index in sorted order by time
-                    insertIndexSorted(dbIndex, thisIndex);
-
-                    continue;
-                }
-
-                // try bool
-                try {
-                    point.rows.push_back({__parse_bool(value)});
-                    continue;
-                
-                } catch (...) {}
-
-                // try double
-                try {
-                    point.rows.push_back({std::stod(value)});
-                    continue;
-                } catch (...) {}
-
-                // try int
-                try {
-                    point.rows.push_back({std::stoi(value)});
-                    continue;
-                } catch (...) {}
-
-                // fallback string
-                point.rows.push_back({value});
-            }
+            // Insert the index in sorted order by time
+            insertIndexSorted(dbIndex, thisIndex);
 
-            csv.points.push_back(point);
+            csv.points.push_back(std::move(point));
         }
     }
 
@@ -106,19 +83,47 @@ CSVData parseCSV(const std::string& filename, FullIndex& dbIndex) {
 }
 
 
-CSVData appendRow(CSVData& csv, const Point& point, FullIndex& dbIndex, NewAdded& newAdded) {
+// Legacy cell decoding, used when a cell does not match its column type.
+PointRow parseCellGeneric(const std::string& value) {
+    // try bool
+    try {
+        return {__parse_bool(value)};
+    } catch (...) {}
+
+    // try double
+    try {
+        return {std::stod(value)};
+    } catch (...) {}
+
+    // try int
+    try {
+        return {std::stoi(value)};
+    } catch (...) {}
+
+    // fallback string
+    return {value};
+}
+
+
+CSVData& appendRow(CSVData& csv, Point point, FullIndex& dbIndex, MemTable& memTable, NewAdded& newAdded) {
     // Store the current size as the index for the new point
     int newIndex = static_cast<int>(csv.points.size());
-    csv.points.push_back(point);
 
     // Update indices
     Index thisIndex;
     thisIndex.index = newIndex;
     thisIndex.time = point.time;
+
+    csv.points.push_back(std::move(point));
         
-    // Update the main index
+    // Update the main index. In-order points go straight to the back,
+    // late points are absorbed by the MemTable until the next merge.
     dbIndex.MAX_ROWNUM++;
-    insertIndexSorted(dbIndex, thisIndex);
+    if (dbIndex.indices.empty() || dbIndex.indices.back().time <= thisIndex.time) {
+        insertIndexSorted(dbIndex, thisIndex);
+    } else {
+        insertMemTable(memTable, thisIndex);
+    }
 
     // Add to newAdded for checkpointing
     newAdded.indices.push_back(thisIndex);
@@ -128,60 +133,153 @@ CSVData appendRow(CSVData& csv, const Point& point, FullIndex& dbIndex, NewAdded
 }
 
 
-std::string variantToString(const std::variant<std::string, double, int, bool>& v) {
-    return std::visit([](auto&& arg) -> std::string {
+// Appends a batch sorted by time. The batch index is merged into dbIndex
+// in one pass instead of one sorted insert per point.
+CSVData& appendRows(CSVData& csv, std::vector<Point>&& points, FullIndex& dbIndex, NewAdded& newAdded) {
+    if (points.empty()) {
+        return csv;
+    }
+
+    auto& indices = dbIndex.indices;
+    size_t middle = indices.size();
+    bool inOrder = indices.empty() || indices.back().time <= points.front().time;
+
+    csv.points.reserve(csv.points.size() + points.size());
+    indices.reserve(indices.size() + points.size());
+    newAdded.indices.reserve(newAdded.indices.size() + points.size());
+
+    for (auto& point : points) {
+        Index thisIndex;
+        thisIndex.index = static_cast<int>(csv.points.size());
+        thisIndex.time = point.time;
+
+        csv.points.push_back(std::move(point));
+        indices.push_back(thisIndex);
+        newAdded.indices.push_back(thisIndex);
+        dbIndex.MAX_ROWNUM++;
+    }
+
+    if (!inOrder) {
+        std::inplace_merge(indices.begin(), indices.begin() + middle, indices.end(),
+            [](const Index& a, const Index& b) {
+                return a.time < b.time;
+            });
+    }
+
+    return csv;
+}
+
+
+// Formats a cell into `out`, reusing its capacity.
+// Matches the default stream formatting (%g) used for numbers so far.
+void variantToString(const std::variant<std::string, double, int, bool>& v, std::string& out) {
+    std::visit([&out](auto&& arg) {
         using T = std::decay_t<decltype(arg)>;
         if constexpr (std::is_same_v<T, std::string>) {
-            return arg;
+            out.assign(arg);
         } else if constexpr (std::is_same_v<T, bool>) {
-            return arg ? "true" : "false";
+            out.assign(arg ? "true" : "false");
         } else {
-            std::ostringstream oss;
-            oss << arg;
-            return oss.str();
+            char buffer[32];
+            int length = std::is_same_v<T, int>
+                ? std::snprintf(buffer, sizeof(buffer), "%d", static_cast<int>(arg))
+                : std::snprintf(buffer, sizeof(buffer), "%g", static_cast<double>(arg));
+            out.assign(buffer, length);
         }
     }, v);
 }
 
 
-std::vector<std::string> pointToVector(const Point& point) {
-    std::vector<std::string> vec;
-    
-    // Add time as the first column
-    vec.push_back(std::to_string(point.time));
+std::string variantToString(const std::variant<std::string, double, int, bool>& v) {
+    std::string out;
+    variantToString(v, out);
+    return out;
+}
+
+
+// Fills `vec` with the CSV cells of a point, reusing the existing strings.
+void pointToVector(const Point& point, std::vector<std::string>& vec) {
+    vec.resize(point.rows.size() + 1);
+
+    // Add time as the first column, formatted like std::to_string
+    char buffer[64];
+    int length = std::snprintf(buffer, sizeof(buffer), "%f", point.time);
+    if (length >= 0 && length < static_cast<int>(sizeof(buffer))) {
+        vec[0].assign(buffer, length);
+    } else {
+        vec[0] = std::to_string(point.time);
+    }
     
     // Add the rest of the row data
-    for (const auto& row : point.rows) {
-        vec.push_back(variantToString(row.data));
+    for (size_t i = 0; i < point.rows.size(); ++i) {
+        variantToString(point.rows[i].data, vec[i + 1]);
     }
+}
 
+
+std::vector<std::string> pointToVector(const Point& point) {
+    std::vector<std::string> vec;
+    pointToVector(point, vec);
     return vec;
 }
 
 
 
+size_t approximateRowSize(const Point& point) {
+    size_t size = 16;  // time and newline
+    for (const auto& row : point.rows) {
+        if (const std::string* value = std::get_if<std::string>(&row.data)) {
+            size += value->size() + 1;
+        } else {
+            size += 10;
+        }
+    }
+    return size;
+}
+
+
+
+void appendCSVRow(const std::vector<std::string>& row, std::string& out) {
+    for (size_t i = 0; i < row.size(); ++i) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += row[i];
+    }
+    out += '\n';
+}
+
+
+
 // Rewrites the complete CSV.
-void writeCSV(const std::string& filename, const CSVData& csv) {
-    std::ofstream file(filename);
+// Rows are encoded with the row codec for csv.types and handed to the I/O
+// backend in one reused line buffer.
+void writeCSV(const std::string& filename, const CSVData& csv, const IOOptions& options) {
+    std::unique_ptr<FileWriter> file = openFileWriter(filename, false, options);
     
-    if (!file.is_open()) {
+    if (!file) {
         throw std::runtime_error("Could not open file");
     }
 
-    csv2::Writer<csv2::delimiter<','>> writer(file);
-    std::vector<std::vector<std::string>> rows;
+    auto codec = makeRowCodec(csv.types);
+    std::string line;
 
     // headers
-    rows.push_back(csv.headers);
+    appendCSVRow(csv.headers, line);
+    bool success = file->write(line);
 
     // rows
-    for (const auto& point : csv.points) {
-        rows.push_back(pointToVector(point));
+    std::vector<std::string> row;
+    for (size_t i = 0; i < csv.points.size() && success; ++i) {
+        codec->serialize(csv.points[i], row);
+        line.clear();
+        appendCSVRow(row, line);
+        success = file->write(line);
     }
 
-    writer.write_rows(rows);
-    file.flush();
-    file.close();
+    if (!file->close() || !success) {
+        throw std::runtime_error("Failed to write file " + filename);
+    }
 }
 
 
@@ -192,7 +290,8 @@ void printCSVData(const CSVData& data) {
 }
 
 
-CSVData deletePointwithIndex(CSVData& data, int index, double time, FullIndex& dbIndex, DeletedIndices& deletedIndices) {
+CSVData& deletePointwithIndex(CSVData& data, int index, double time, FullIndex& dbIndex,
+                              MemTable& memTable, NewAdded& newAdded, DeletedIndices& deletedIndices) {
     if (index >= 0 && index < data.points.size()) {
         // Record this deletion in the global deletedIndices
         Index thisDeletedIndex;
@@ -203,20 +302,26 @@ CSVData deletePointwithIndex(CSVData& data, int index, double time, FullIndex& d
         // Remove the point from the data
         data.points.erase(data.points.begin() + index);
 
-        // Find and remove the corresponding index from dbIndex
-        auto it = std::find_if(dbIndex.indices.begin(), dbIndex.indices.end(),
-            [index](const Index& idx) { return idx.index == index; });
-            
-        if (it != dbIndex.indices.end()) {
-            dbIndex.indices.erase(it);
-        }
+        // Find and remove the corresponding index from dbIndex, the MemTable and newAdded
+        auto removeIndex = [index](std::vector<Index>& indices) {
+            auto it = std::find_if(indices.begin(), indices.end(),
+                [index](const Index& idx) { return idx.index == index; });
 
-        // Adjust indices in dbIndex that are greater than the deleted one
-        for (auto& idx : dbIndex.indices) {
-            if (idx.index > index) {
-                idx.index--;
+            if (it != indices.end()) {
+                indices.erase(it);
             }
-        }
+
+            // Adjust indices that are greater than the deleted one
+            for (auto& idx : indices) {
+                if (idx.index > index) {
+                    idx.index--;
+                }
+            }
+        };
+
+        removeIndex(dbIndex.indices);
+        removeIndex(memTable.indices);
+        removeIndex(newAdded.indices);
 
         // Update MAX_ROWNUM if needed
         if (dbIndex.MAX_ROWNUM > 0) {
@@ -228,6 +333,90 @@ CSVData deletePointwithIndex(CSVData& data, int index, double time, FullIndex& d
 }
 
 
+// Reorders rows so that data.points follows the time-sorted index.
+// Used before full rewrites so the file on disk is always sorted by time.
+// Expects the MemTable to be merged into dbIndex beforehand.
+void sortPointsByTime(CSVData& data, FullIndex& dbIndex) {
+    std::vector<Point> sorted;
+    sorted.reserve(dbIndex.indices.size());
+
+    for (auto& idx : dbIndex.indices) {
+        if (idx.index < 0 || idx.index >= static_cast<int>(data.points.size())) {
+            continue;
+        }
+        sorted.push_back(std::move(data.points[idx.index]));
+        idx.index = static_cast<int>(sorted.size()) - 1;
+    }
+
+    data.points = std::move(sorted);
+    dbIndex.MAX_ROWNUM = static_cast<int>(data.points.size());
+}
+
+
+// Header cells may carry the whitespace of the CSV file.
+static bool headerMatches(const std::string& header, const std::string& name) {
+    size_t first = header.find_first_not_of(" \t\r\n");
+    if (first == std::string::npos) {
+        return false;
+    }
+    size_t last = header.find_last_not_of(" \t\r\n");
+    return header.compare(first, last - first + 1, name) == 0;
+}
+
+
+int findColumn(const std::vector<std::string>& headers, const std::string& name) {
+    // Column 0 is time, Point::rows starts at column 1.
+    for (size_t i = 1; i < headers.size(); ++i) {
+        if (headerMatches(headers[i], name)) {
+            return static_cast<int>(i) - 1;
+        }
+    }
+    return -1;
+}
+
+
+std::vector<int> resolveProjection(const std::vector<std::string>& headers, const std::vector<std::string>& columns) {
+    std::vector<int> projection;
+    projection.reserve(columns.size());
+    for (const auto& column : columns) {
+        if (!headers.empty() && headerMatches(headers[0], column)) {
+            continue;
+        }
+        int position = findColumn(headers, column);
+        if (position < 0) {
+            throw std::invalid_argument("Unknown column: " + column);
+        }
+        projection.push_back(position);
+    }
+    return projection;
+}
+
+
+void projectPoint(const Point& source, const std::vector<int>& projection, Point& out) {
+    out.time = source.time;
+    out.rows.resize(projection.size());
+    for (size_t i = 0; i < projection.size(); ++i) {
+        size_t position = static_cast<size_t>(projection[i]);
+        // Short rows read as an empty cell, like in the full result
+        out.rows[i] = position < source.rows.size() ? source.rows[position] : PointRow{};
+    }
+}
+
+
+bool numericValue(const PointRow& row, double& out) {
+    if (std::holds_alternative<double>(row.data)) {
+        out = std::get<double>(row.data);
+    } else if (std::holds_alternative<int>(row.data)) {
+        out = std::get<int>(row.data);
+    } else if (std::holds_alternative<bool>(row.data)) {
+        out = std::get<bool>(row.data) ? 1.0 : 0.0;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
 // Private utility function.
 bool __parse_bool(const std::string& value) {
     std::string val = value;
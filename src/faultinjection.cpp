@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+
+#include "../include/internal/faultinjection.hpp"
+
+// Fault injection state.
+// The armed flag keeps the unarmed path to one atomic load per operation.
+
+namespace {
+
+std::atomic<bool> armed{false};
+std::mutex stateMutex;
+FaultPlan plan;
+uint64_t operations = 0;
+bool triggered = false;
+bool crashed = false;
+
+const char* siteName(FaultSite site) {
+    switch (site) {
+        case FaultSite::Write:
+            return "write";
+        case FaultSite::Sync:
+            return "sync";
+        case FaultSite::Rename:
+            return "rename";
+    }
+    return "operation";
+}
+
+}  // namespace
+
+
+void armFaults(const FaultPlan& newPlan) {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    plan = newPlan;
+    operations = 0;
+    triggered = false;
+    crashed = false;
+    armed = true;
+}
+
+
+void disarmFaults() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    armed = false;
+    crashed = false;
+}
+
+
+bool faultsArmed() {
+    return armed;
+}
+
+
+uint64_t faultOperationCount() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return operations;
+}
+
+
+bool faultTriggered() {
+    std::lock_guard<std::mutex> lock(stateMutex);
+    return triggered;
+}
+
+
+FaultAction injectFault(FaultSite site, const std::string& path, size_t* size) {
+    if (!armed) {
+        return FaultAction::Proceed;
+    }
+
+    std::lock_guard<std::mutex> lock(stateMutex);
+    if (crashed) {
+        return FaultAction::Fail;
+    }
+    if (++operations != plan.operation) {
+        return FaultAction::Proceed;
+    }
+
+    triggered = true;
+    switch (plan.kind) {
+        case FaultKind::Fail:
+            return FaultAction::Fail;
+        case FaultKind::Torn:
+            if (size != nullptr && *size > 0) {
+                double fraction = std::clamp(plan.tornFraction, 0.0, 1.0);
+                *size = std::min(*size - 1, static_cast<size_t>(static_cast<double>(*size) * fraction));
+                return FaultAction::Torn;
+            }
+            break;
+        case FaultKind::Crash:
+            break;
+    }
+
+    crashed = true;
+    throw SimulatedCrash{std::string("Simulated crash before ") + siteName(site) + " of " + path};
+}
+
+
+void crashAfterTornWrite(const std::string& path) {
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        crashed = true;
+    }
+    throw SimulatedCrash{"Simulated crash after a torn write of " + path};
+}
@@ -1,4 +1,13 @@
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
 #include "../include/internal/fileio.hpp"
+#include "../include/internal/faultinjection.hpp"
 
 namespace fs = std::filesystem;
 
@@ -7,6 +16,10 @@ bool createShadowCopy(const std::string& path) {
     fs::path original(path);
     fs::path shadow(shadowStr);
     
+    if (injectFault(FaultSite::Write, shadowStr) == FaultAction::Fail) {
+        return false;
+    }
+
     try {
         // Copy with overwrite if exists
         fs::copy_file(original, shadow, fs::copy_options::overwrite_existing);
@@ -22,6 +35,10 @@ bool swapShadowAsDb(const std::string& path, int maxRetries) {
 
     for (int attempt = 1; attempt <= maxRetries; ++attempt) {
         try {
+            if (injectFault(FaultSite::Rename, path) == FaultAction::Fail) {
+                throw fs::filesystem_error("Injected rename failure", shadow, original,
+                                           std::make_error_code(std::errc::io_error));
+            }
             fs::rename(shadow, original);
             return true;
         } catch (const fs::filesystem_error& e) {
@@ -34,3 +51,55 @@ bool swapShadowAsDb(const std::string& path, int maxRetries) {
     return false;
 }
 
+
+bool syncDirectory(const std::string& path) {
+    if (injectFault(FaultSite::Sync, path) == FaultAction::Fail) {
+        return false;
+    }
+#ifdef _WIN32
+    return true;  // Renames are not synced through directory handles on Windows
+#else
+    fs::path parent = fs::path(path).parent_path();
+    std::string directory = parent.empty() ? "." : parent.string();
+
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool success = ::fsync(fd) == 0;
+    ::close(fd);
+    return success;
+#endif
+}
+
+bool truncatePartialTail(const std::string& path, uint64_t committedSize) {
+    std::error_code error;
+    uint64_t size = fs::file_size(path, error);
+    if (error || size <= committedSize) {
+        return false;
+    }
+
+    // Every committed row ends with a newline, keep everything up to the last one.
+    std::ifstream file(path, std::ios::binary);
+    std::vector<char> tail(size - committedSize);
+    file.seekg(static_cast<std::streamoff>(committedSize));
+    if (!file.read(tail.data(), static_cast<std::streamsize>(tail.size()))) {
+        return false;
+    }
+    file.close();
+
+    uint64_t keep = tail.size();
+    while (keep > 0 && tail[keep - 1] != '\n') {
+        keep--;
+    }
+    if (keep == tail.size()) {
+        return false;
+    }
+
+    fs::resize_file(path, committedSize + keep, error);
+    if (error) {
+        return false;
+    }
+    std::cerr << "Warning: Dropped " << (tail.size() - keep) << " bytes of a partial row at the end of " << path << "\n";
+    return true;
+}
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#include "../include/internal/hotwindow.hpp"
+
+// Hot window ring.
+// All atomics use sequentially consistent ordering. Reclamation relies on it:
+// the writer unlinks an entry before it advances the epoch and scans the
+// reader slots. A reader announces its epoch before it loads any entry, so
+// either the scan sees the announcement, or the reader only loads the
+// replacement. An epoch read before the advance is only ever announced as
+// older, which holds entries back longer but never frees them early.
+
+
+// Claims a reader slot for the duration of a query.
+class HotWindow::ReaderGuard {
+public:
+    explicit ReaderGuard(const HotWindow& window) {
+        // Threads start probing at different slots, so they rarely contend
+        thread_local size_t hint = std::hash<std::thread::id>()(std::this_thread::get_id());
+        for (size_t i = 0; i < READER_SLOTS; ++i) {
+            ReaderSlot& candidate = window.readerSlots[(hint + i) % READER_SLOTS];
+            uint64_t free = 0;
+            if (candidate.epoch.compare_exchange_strong(free, window.epoch.load())) {
+                slot = &candidate;
+                return;
+            }
+        }
+    }
+
+    ~ReaderGuard() {
+        if (slot != nullptr) {
+            slot->epoch.store(0);
+        }
+    }
+
+    bool entered() const {
+        return slot != nullptr;
+    }
+
+private:
+    ReaderSlot* slot = nullptr;
+};
+
+
+HotWindow::Ring::~Ring() {
+    for (size_t i = 0; i < capacity; ++i) {
+        delete slots[i].load();
+    }
+}
+
+
+HotWindow::~HotWindow() {
+    delete ring.load();
+    for (const auto& retired : retiredEntries) {
+        delete retired.object;
+    }
+    for (const auto& retired : retiredRings) {
+        delete retired.object;
+    }
+}
+
+
+void HotWindow::configure(size_t capacity, double seconds, const std::vector<std::string>& headers,
+                          const std::vector<ColumnType>& types, const std::vector<const Point*>& newest) {
+    Ring* replacement = nullptr;
+    if (capacity > 0) {
+        replacement = new Ring();
+        replacement->capacity = capacity;
+        replacement->seconds = seconds;
+        replacement->headers = headers;
+        replacement->types = types;
+        replacement->slots.reset(new std::atomic<Entry*>[capacity]);
+        for (size_t i = 0; i < capacity; ++i) {
+            replacement->slots[i] = nullptr;
+        }
+        // Seeded before it is published, readers never see a partial ring
+        for (const Point* point : newest) {
+            publish(replacement, *point);
+        }
+    }
+
+    Ring* previous = ring.exchange(replacement);
+    if (previous != nullptr) {
+        retiredRings.push_back({epoch.load(), previous});
+        retiredCount++;
+    }
+    reclaim();
+}
+
+
+bool HotWindow::enabled() const {
+    return ring.load() != nullptr;
+}
+
+
+void HotWindow::push(const Point& point) {
+    Ring* current = ring.load();
+    if (current == nullptr) {
+        return;
+    }
+    publish(current, point);
+    reclaim();
+}
+
+
+void HotWindow::invalidate(double time) {
+    Ring* current = ring.load();
+    if (current == nullptr) {
+        return;
+    }
+    uint64_t tail = current->tail.load();
+    if (tail == current->head.load()) {
+        return;
+    }
+    if (time >= entryAt(*current, tail)->point.time) {
+        clear();
+    }
+}
+
+
+void HotWindow::clear() {
+    Ring* current = ring.load();
+    if (current != nullptr) {
+        current->tail.store(current->head.load());
+    }
+}
+
+
+void HotWindow::publish(Ring* target, const Point& point) {
+    uint64_t seq = target->head.load();
+    Entry* previous = target->slots[seq % target->capacity].exchange(new Entry{seq, point});
+    if (previous != nullptr) {
+        retiredEntries.push_back({epoch.load(), previous});
+        retiredCount++;
+    }
+    target->head.store(seq + 1);
+
+    // Keep at most `capacity` points and, with a time window, the last `seconds`.
+    uint64_t tail = target->tail.load();
+    if (seq + 1 - tail > target->capacity) {
+        tail = seq + 1 - target->capacity;
+    }
+    if (target->seconds > 0.0) {
+        while (tail < seq && entryAt(*target, tail)->point.time < point.time - target->seconds) {
+            tail++;
+        }
+    }
+    target->tail.store(tail);
+}
+
+
+void HotWindow::reclaim() {
+    if (retiredEntries.size() < RECLAIM_BATCH && retiredRings.empty()) {
+        return;
+    }
+
+    // Readers announcing an epoch from now on cannot see anything retired so
+    // far. Everything retired before the oldest epoch still announced is free.
+    epoch++;
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    for (const auto& slot : readerSlots) {
+        uint64_t announced = slot.epoch.load();
+        if (announced != 0) {
+            oldest = std::min(oldest, announced);
+        }
+    }
+
+    auto release = [&](auto& retired) {
+        size_t count = 0;
+        while (count < retired.size() && retired[count].epoch < oldest) {
+            delete retired[count].object;
+            count++;
+        }
+        retired.erase(retired.begin(), retired.begin() + count);
+        retiredCount -= count;
+    };
+    release(retiredEntries);
+    release(retiredRings);
+}
+
+
+const HotWindow::Entry* HotWindow::entryAt(const Ring& ring, uint64_t seq) {
+    const Entry* entry = ring.slots[seq % ring.capacity].load();
+    return entry != nullptr && entry->seq == seq ? entry : nullptr;
+}
+
+
+uint64_t HotWindow::lowerBound(const Ring& ring, uint64_t first, uint64_t last, double time, bool after,
+                               bool& lapped) {
+    while (first < last) {
+        uint64_t middle = first + (last - first) / 2;
+        const Entry* entry = entryAt(ring, middle);
+        if (entry == nullptr) {
+            lapped = true;
+            return last;
+        }
+        if (entry->point.time < time || (after && entry->point.time == time)) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+
+bool HotWindow::snapshot(double startTime, Snapshot& snap) const {
+    const Ring* current = ring.load();
+    if (current == nullptr) {
+        return false;
+    }
+    snap.ring = current;
+    snap.last = current->head.load();
+    snap.first = current->tail.load();
+    if (snap.first >= snap.last) {
+        return false;
+    }
+
+    // Covered only if nothing before the oldest entry can match
+    const Entry* oldest = entryAt(*current, snap.first);
+    return oldest != nullptr && startTime >= oldest->point.time;
+}
+
+
+bool HotWindow::copyRange(const Snapshot& snap, uint64_t first, uint64_t last,
+                          const std::vector<std::string>& columns, CSVData& result) {
+    std::vector<int> projection = resolveProjection(snap.ring->headers, columns);
+    bool projected = !columns.empty();
+
+    result.headers.assign(snap.ring->headers.begin(), snap.ring->headers.begin() + (projected ? 1 : snap.ring->headers.size()));
+    result.types = projected ? std::vector<ColumnType>() : snap.ring->types;
+    for (int position : projection) {
+        result.headers.push_back(snap.ring->headers[position + 1]);
+        if (position < static_cast<int>(snap.ring->types.size())) {
+            result.types.push_back(snap.ring->types[position]);
+        }
+    }
+    if (projected && result.types.size() != projection.size()) {
+        result.types.clear();
+    }
+
+    result.points.resize(last - first);
+    for (uint64_t seq = first; seq < last; ++seq) {
+        const Entry* entry = entryAt(*snap.ring, seq);
+        if (entry == nullptr) {
+            return false;  // Lapped by the writer
+        }
+        Point& out = result.points[seq - first];
+        if (projected) {
+            projectPoint(entry->point, projection, out);
+        } else {
+            out = entry->point;
+        }
+    }
+    return true;
+}
+
+
+bool HotWindow::read(double time, const std::vector<std::string>& columns, CSVData& result) {
+    ReaderGuard guard(*this);
+    Snapshot snap;
+    bool lapped = false;
+    if (guard.entered() && snapshot(time, snap)) {
+        uint64_t found = lowerBound(*snap.ring, snap.first, snap.last, time, false, lapped);
+        const Entry* entry = found < snap.last ? entryAt(*snap.ring, found) : nullptr;
+        lapped = lapped || (found < snap.last && entry == nullptr);
+        bool exact = entry != nullptr && entry->point.time == time;
+        if (!lapped && copyRange(snap, found, exact ? found + 1 : found, columns, result)) {
+            hits++;
+            return true;
+        }
+    }
+    if (enabled()) {
+        misses++;
+    }
+    return false;
+}
+
+
+bool HotWindow::readRange(double startTime, double endTime, const std::vector<std::string>& columns,
+                          CSVData& result) {
+    ReaderGuard guard(*this);
+    Snapshot snap;
+    bool lapped = false;
+    if (guard.entered() && snapshot(startTime, snap)) {
+        uint64_t first = lowerBound(*snap.ring, snap.first, snap.last, startTime, false, lapped);
+        uint64_t last = first;
+        if (!lapped && startTime <= endTime) {
+            last = lowerBound(*snap.ring, first, snap.last, endTime, true, lapped);
+        }
+        if (!lapped && copyRange(snap, first, last, columns, result)) {
+            hits++;
+            return true;
+        }
+    }
+    if (enabled()) {
+        misses++;
+    }
+    return false;
+}
+
+
+bool HotWindow::aggregate(double startTime, double endTime, const std::string& column, RangeAggregate& result) {
+    ReaderGuard guard(*this);
+    Snapshot snap;
+    bool lapped = false;
+    if (guard.entered() && snapshot(startTime, snap)) {
+        int position = findColumn(snap.ring->headers, column);
+        uint64_t first = lowerBound(*snap.ring, snap.first, snap.last, startTime, false, lapped);
+        RangeAggregate local;
+        for (uint64_t seq = first; position >= 0 && !lapped && seq < snap.last; ++seq) {
+            const Entry* entry = entryAt(*snap.ring, seq);
+            if (entry == nullptr) {
+                lapped = true;
+            } else if (entry->point.time > endTime) {
+                break;
+            } else {
+                double value;
+                const auto& rows = entry->point.rows;
+                if (position < static_cast<int>(rows.size()) && numericValue(rows[position], value)) {
+                    local.add(value);
+                }
+            }
+        }
+        // Unknown columns are reported by the main store
+        if (position >= 0 && !lapped) {
+            result = local;
+            hits++;
+            return true;
+        }
+    }
+    if (enabled()) {
+        misses++;
+    }
+    return false;
+}
+
+
+HotWindowStats HotWindow::stats() const {
+    ReaderGuard guard(*this);
+    HotWindowStats result;
+    result.hits = hits;
+    result.misses = misses;
+    result.retired = retiredCount;
+
+    const Ring* current = guard.entered() ? ring.load() : nullptr;
+    if (current != nullptr) {
+        uint64_t last = current->head.load();
+        uint64_t first = current->tail.load();
+        const Entry* oldest = first < last ? entryAt(*current, first) : nullptr;
+        const Entry* newest = first < last ? entryAt(*current, last - 1) : nullptr;
+        if (oldest != nullptr && newest != nullptr) {
+            result.points = last - first;
+            result.oldestTime = oldest->point.time;
+            result.newestTime = newest->point.time;
+        }
+    }
+    return result;
+}
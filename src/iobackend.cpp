@@ -0,0 +1,417 @@
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #include <sys/stat.h>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/stat.h>
+#endif
+
+#if defined(STAMPDB_WITH_IO_URING) && defined(__linux__)
+    #include <liburing.h>
+    #define STAMPDB_IO_URING 1
+#endif
+
+#include "../include/internal/iobackend.hpp"
+#include "../include/internal/faultinjection.hpp"
+
+// Storage I/O backends.
+// Both writers own their buffers, so callers hand over whole rows without
+// going through iostreams.
+
+namespace {
+
+int openForWrite(const std::string& path, bool append, int extraFlags = 0) {
+#ifdef _WIN32
+    int flags = _O_WRONLY | _O_CREAT | _O_BINARY | (append ? _O_APPEND : _O_TRUNC);
+    return _open(path.c_str(), flags | extraFlags, _S_IREAD | _S_IWRITE);
+#else
+    int flags = O_WRONLY | O_CREAT | O_CLOEXEC | (append ? O_APPEND : O_TRUNC);
+    return ::open(path.c_str(), flags | extraFlags, 0644);
+#endif
+}
+
+
+bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(fd, data, static_cast<unsigned int>(std::min<size_t>(size, INT_MAX)));
+#else
+        ssize_t written = ::write(fd, data, size);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+
+void closeDescriptor(int fd) {
+#ifdef _WIN32
+    _close(fd);
+#else
+    ::close(fd);
+#endif
+}
+
+
+bool syncAndClose(int fd, const std::string& path, bool sync, bool dropCache) {
+    // Injected fsync failures and crashes still close the file
+    FaultAction action = FaultAction::Proceed;
+    try {
+        if (sync) {
+            action = injectFault(FaultSite::Sync, path);
+        }
+    } catch (...) {
+        closeDescriptor(fd);
+        throw;
+    }
+    if (action == FaultAction::Fail) {
+        closeDescriptor(fd);
+        return false;
+    }
+
+#ifdef _WIN32
+    bool success = !sync || _commit(fd) == 0;
+    (void)dropCache;
+    return _close(fd) == 0 && success;
+#else
+    bool success = !sync || ::fsync(fd) == 0;
+    #ifdef POSIX_FADV_DONTNEED
+        // Written pages are clean after fsync and can be dropped from the cache.
+        if (success && sync && dropCache) {
+            ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        }
+    #else
+        (void)dropCache;
+    #endif
+    return ::close(fd) == 0 && success;
+#endif
+}
+
+
+// Buffered write(2). With directIO the written pages are dropped from the
+// page cache once they are synced.
+class PosixFileWriter : public FileWriter {
+public:
+    PosixFileWriter(int fd, const std::string& path, const IOOptions& options)
+        : fd(fd), path(path), options(options) {
+        buffer.reserve(options.bufferSize);
+    }
+
+    ~PosixFileWriter() override {
+        if (fd >= 0) {
+            try {
+                close();
+            } catch (...) {
+                // A simulated crash while unwinding, the fault state stays crashed
+            }
+        }
+    }
+
+    bool write(const char* data, size_t size) override {
+        if (failed) {
+            return false;
+        }
+        if (buffer.size() + size > options.bufferSize && !flush()) {
+            return false;
+        }
+        if (size >= options.bufferSize) {
+            failed = !writeOut(data, size);
+            return !failed;
+        }
+        buffer.append(data, size);
+        return true;
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return !failed;
+        }
+        bool flushed = flush();
+        int closing = fd;
+        fd = -1;
+        bool closed = syncAndClose(closing, path, options.sync, options.directIO);
+        return flushed && closed && !failed;
+    }
+
+private:
+    bool flush() {
+        if (!buffer.empty()) {
+            failed = failed || !writeOut(buffer.data(), buffer.size());
+            buffer.clear();
+        }
+        return !failed;
+    }
+
+    // One write(2) batch, the unit that fault injection fails or tears.
+    bool writeOut(const char* data, size_t size) {
+        size_t length = size;
+        FaultAction action = injectFault(FaultSite::Write, path, &length);
+        if (action == FaultAction::Fail) {
+            return false;
+        }
+        bool written = writeAll(fd, data, length);
+        if (action == FaultAction::Torn) {
+            crashAfterTornWrite(path);
+        }
+        return written;
+    }
+
+    int fd;
+    std::string path;
+    IOOptions options;
+    std::string buffer;
+    bool failed = false;
+};
+
+
+#ifdef STAMPDB_IO_URING
+
+// O_DIRECT needs buffer addresses, sizes and file offsets aligned to the
+// logical block size. 4096 covers all common devices.
+constexpr size_t kDirectAlignment = 4096;
+
+
+// io_uring writer with `queueDepth` buffers. A full buffer is submitted at its
+// file offset and filling continues in the next free buffer, so the device
+// always has several writes queued. Truncating writes can use O_DIRECT; the
+// last block is padded to the alignment and the file trimmed on close.
+class IoUringFileWriter : public FileWriter {
+public:
+    ~IoUringFileWriter() override {
+        if (fd >= 0) {
+            close();
+        }
+        if (ringReady) {
+            io_uring_queue_exit(&ring);
+        }
+        for (auto& slot : slots) {
+            std::free(slot.data);
+        }
+    }
+
+    // Returns false if io_uring or the buffers cannot be set up, the caller
+    // then falls back to the POSIX writer.
+    bool open(const std::string& path, bool append, const IOOptions& options) {
+        unsigned depth = std::max(options.queueDepth, 1u);
+        if (io_uring_queue_init(depth, &ring, 0) < 0) {
+            return false;
+        }
+        ringReady = true;
+
+        this->path = path;
+        sync = options.sync;
+        bufferSize = (std::max<size_t>(options.bufferSize, kDirectAlignment) + kDirectAlignment - 1)
+                     / kDirectAlignment * kDirectAlignment;
+        slots.resize(depth);
+        for (auto& slot : slots) {
+            if (posix_memalign(reinterpret_cast<void**>(&slot.data), kDirectAlignment, bufferSize) != 0) {
+                slot.data = nullptr;
+                return false;
+            }
+        }
+
+        if (append) {
+            // Explicit offsets instead of O_APPEND, completions may arrive out of order.
+            // Appends start at an unaligned end of file, so they never use O_DIRECT.
+            fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_CLOEXEC, 0644);
+            struct stat info;
+            if (fd < 0 || ::fstat(fd, &info) != 0) {
+                return false;
+            }
+            offset = static_cast<uint64_t>(info.st_size);
+            return true;
+        }
+
+        if (options.directIO) {
+            fd = openForWrite(path, false, O_DIRECT);
+            direct = fd >= 0;  // Not every filesystem supports O_DIRECT
+        }
+        if (fd < 0) {
+            fd = openForWrite(path, false);
+        }
+        return fd >= 0;
+    }
+
+    bool write(const char* data, size_t size) override {
+        while (size > 0 && !failed) {
+            Slot& slot = slots[current];
+            size_t chunk = std::min(size, bufferSize - slot.used);
+            std::memcpy(slot.data + slot.used, data, chunk);
+            slot.used += chunk;
+            data += chunk;
+            size -= chunk;
+
+            if (slot.used == bufferSize) {
+                submit(slot, bufferSize);
+                nextSlot();
+            }
+        }
+        return !failed;
+    }
+
+    bool close() override {
+        if (fd < 0) {
+            return !failed;
+        }
+
+        Slot& slot = slots[current];
+        uint64_t fileSize = offset + slot.used;
+        if (slot.used > 0 && !failed) {
+            size_t length = slot.used;
+            if (direct) {
+                length = (length + kDirectAlignment - 1) / kDirectAlignment * kDirectAlignment;
+                std::memset(slot.data + slot.used, 0, length - slot.used);
+            }
+            submit(slot, length);
+        }
+        while (inFlight > 0) {
+            reap();
+        }
+
+        if (!failed && direct && ::ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+            failed = true;
+        }
+        if (!syncAndClose(fd, path, sync && !failed, false)) {
+            failed = true;
+        }
+        fd = -1;
+        return !failed;
+    }
+
+private:
+    struct Slot {
+        char* data = nullptr;
+        size_t used = 0;       // Bytes filled
+        size_t length = 0;     // Bytes submitted
+        size_t done = 0;       // Bytes completed
+        uint64_t offset = 0;   // File offset of data[0]
+        bool inFlight = false;
+    };
+
+    void submit(Slot& slot, size_t length) {
+        slot.length = length;
+        slot.done = 0;
+        slot.offset = offset;
+        slot.inFlight = true;
+        offset += slot.used;
+        inFlight++;
+        queue(slot);
+    }
+
+    void queue(Slot& slot) {
+        io_uring_sqe* sqe = io_uring_get_sqe(&ring);
+        if (sqe == nullptr) {
+            failed = true;
+            slot.inFlight = false;
+            inFlight--;
+            return;
+        }
+        io_uring_prep_write(sqe, fd, slot.data + slot.done, static_cast<unsigned>(slot.length - slot.done),
+                            slot.offset + slot.done);
+        io_uring_sqe_set_data(sqe, &slot);
+        if (io_uring_submit(&ring) < 0) {
+            failed = true;
+        }
+    }
+
+    // Waits for one completion. Short writes are resubmitted for the rest.
+    void reap() {
+        io_uring_cqe* cqe = nullptr;
+        int result = io_uring_wait_cqe(&ring, &cqe);
+        if (result < 0) {
+            if (result != -EINTR) {
+                failed = true;
+                inFlight = 0;
+            }
+            return;
+        }
+
+        Slot* slot = static_cast<Slot*>(io_uring_cqe_get_data(cqe));
+        int written = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+
+        if (written <= 0) {
+            failed = true;
+        } else {
+            slot->done += static_cast<size_t>(written);
+            if (slot->done < slot->length && !failed) {
+                queue(*slot);
+                return;
+            }
+        }
+        slot->inFlight = false;
+        slot->used = 0;
+        inFlight--;
+    }
+
+    void nextSlot() {
+        current = (current + 1) % slots.size();
+        while (slots[current].inFlight && !failed) {
+            reap();
+        }
+    }
+
+    io_uring ring;
+    bool ringReady = false;
+    int fd = -1;
+    std::string path;
+    bool direct = false;
+    bool sync = false;
+    bool failed = false;
+    size_t bufferSize = 0;
+    uint64_t offset = 0;  // File offset of the next submitted buffer
+    std::vector<Slot> slots;
+    size_t current = 0;
+    unsigned inFlight = 0;
+};
+
+#endif
+
+}  // namespace
+
+
+std::unique_ptr<FileWriter> openFileWriter(const std::string& path, bool append, const IOOptions& options) {
+#ifdef STAMPDB_IO_URING
+    // Faults are injected on the POSIX path, which then covers every write
+    if (options.backend == IOBackendKind::IoUring && !faultsArmed()) {
+        auto writer = std::make_unique<IoUringFileWriter>();
+        if (writer->open(path, append, options)) {
+            return writer;
+        }
+        writer.reset();
+        std::cerr << "Warning: io_uring is unavailable, using POSIX writes for " << path << std::endl;
+    }
+#endif
+
+    int fd = openForWrite(path, append);
+    if (fd < 0) {
+        return nullptr;
+    }
+    return std::make_unique<PosixFileWriter>(fd, path, options);
+}
+
+
+bool ioUringAvailable() {
+#ifdef STAMPDB_IO_URING
+    return true;
+#else
+    return false;
+#endif
+}
@@ -0,0 +1,31 @@
+#include "../include/internal/parallel.hpp"
+
+// Intra-query parallelism.
+// A query splits its slice of the index into morsels which are scanned by
+// short-lived workers. Each worker writes to its own output slice or partial
+// aggregate, so no locking is needed on the hot path.
+
+
+void RangeAggregate::add(double value) {
+    count++;
+    sum += value;
+    min = std::min(min, value);
+    max = std::max(max, value);
+}
+
+
+void RangeAggregate::merge(const RangeAggregate& other) {
+    count += other.count;
+    sum += other.sum;
+    min = std::min(min, other.min);
+    max = std::max(max, other.max);
+}
+
+
+int resolveThreadCount(int requested) {
+    if (requested > 0) {
+        return requested;
+    }
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware > 0 ? static_cast<int>(hardware) : 1;
+}
@@ -0,0 +1,92 @@
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <stdexcept>
+
+#include "../include/internal/resample.hpp"
+
+// Resampling.
+// A cursor follows the grid through the sorted index, so every row between
+// the first and the last grid time is visited once.
+
+namespace {
+
+double cellValue(const CSVData& data, const Index& idx, int position) {
+    const auto& rows = data.points[idx.index].rows;
+    double value;
+    if (position < static_cast<int>(rows.size()) && numericValue(rows[position], value)) {
+        return value;
+    }
+    return std::numeric_limits<double>::quiet_NaN();
+}
+
+}  // namespace
+
+
+size_t resampleSize(double startTime, double endTime, double step) {
+    if (!(step > 0.0) || !std::isfinite(step) || !std::isfinite(startTime) || !std::isfinite(endTime)) {
+        throw std::invalid_argument("Resample step must be positive and times must be finite");
+    }
+    if (endTime < startTime) {
+        return 0;
+    }
+    size_t size = static_cast<size_t>(std::floor((endTime - startTime) / step)) + 1;
+    // Rounding can push the last grid time past the end
+    if (size > 1 && startTime + static_cast<double>(size - 1) * step > endTime) {
+        size--;
+    }
+    return size;
+}
+
+
+void resampleGrid(const CSVData& data, const std::vector<Index>& index, double startTime, double step,
+                  size_t first, size_t last, ResampleMethod method, const std::vector<int>& positions, double* out) {
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    size_t width = positions.size() + 1;
+    if (first >= last) {
+        return;
+    }
+
+    // `next` is the first row after the current grid time, the row before it
+    // is the last one at or before it
+    double firstTime = startTime + static_cast<double>(first) * step;
+    auto next = std::upper_bound(index.begin(), index.end(), firstTime,
+        [](double time, const Index& idx) { return time < idx.time; });
+
+    for (size_t row = first; row < last; ++row) {
+        double time = startTime + static_cast<double>(row) * step;
+        while (next != index.end() && next->time <= time) {
+            ++next;
+        }
+        const Index* before = next != index.begin() ? &*std::prev(next) : nullptr;
+        const Index* after = next != index.end() ? &*next : nullptr;
+
+        double* cells = out + row * width;
+        cells[0] = time;
+        for (size_t c = 0; c < positions.size(); ++c) {
+            double value = nan;
+            switch (method) {
+                case ResampleMethod::Linear:
+                    if (before != nullptr && before->time == time) {
+                        value = cellValue(data, *before, positions[c]);
+                    } else if (before != nullptr && after != nullptr) {
+                        double a = cellValue(data, *before, positions[c]);
+                        double b = cellValue(data, *after, positions[c]);
+                        value = a + (b - a) * (time - before->time) / (after->time - before->time);
+                    }
+                    break;
+                case ResampleMethod::Previous:
+                    if (before != nullptr) {
+                        value = cellValue(data, *before, positions[c]);
+                    }
+                    break;
+                case ResampleMethod::Null:
+                    if (before != nullptr && time - before->time < step) {
+                        value = cellValue(data, *before, positions[c]);
+                    }
+                    break;
+            }
+            cells[c + 1] = value;
+        }
+    }
+}
@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+#include "../include/internal/resultcache.hpp"
+
+// Query result cache.
+// Entries live in an LRU list; the map finds them by key. Invalidation walks
+// all entries, which stays cheap because the memory cap keeps the cache small
+// compared to the data.
+
+
+bool ResultCacheKey::cacheable() const {
+    return !std::isnan(startTime) && !std::isnan(endTime);
+}
+
+
+bool ResultCacheKey::operator<(const ResultCacheKey& other) const {
+    return std::tie(kind, startTime, endTime, columns, predicate) <
+           std::tie(other.kind, other.startTime, other.endTime, other.columns, other.predicate);
+}
+
+
+size_t approximateResultBytes(const CSVData& rows) {
+    size_t bytes = sizeof(CSVData);
+    for (const auto& header : rows.headers) {
+        bytes += sizeof(std::string) + header.capacity();
+    }
+    for (const auto& point : rows.points) {
+        bytes += sizeof(Point) + point.rows.capacity() * sizeof(PointRow);
+        for (const auto& row : point.rows) {
+            if (const std::string* value = std::get_if<std::string>(&row.data)) {
+                bytes += value->capacity();
+            }
+        }
+    }
+    return bytes;
+}
+
+
+ResultCache::ResultCache(size_t capacityBytes) : capacityBytes(capacityBytes) {}
+
+
+void ResultCache::setCapacity(size_t bytes) {
+    capacityBytes = bytes;
+    evictToCapacity();
+}
+
+
+const CSVData* ResultCache::findRows(const ResultCacheKey& key) {
+    if (!enabled() || !key.cacheable()) {
+        return nullptr;
+    }
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        counters.misses++;
+        return nullptr;
+    }
+    counters.hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->rows;
+}
+
+
+const RangeAggregate* ResultCache::findAggregate(const ResultCacheKey& key) {
+    if (!enabled() || !key.cacheable()) {
+        return nullptr;
+    }
+    auto it = entries.find(key);
+    if (it == entries.end()) {
+        counters.misses++;
+        return nullptr;
+    }
+    counters.hits++;
+    lru.splice(lru.begin(), lru, it->second);
+    return &it->second->aggregate;
+}
+
+
+void ResultCache::putRows(const ResultCacheKey& key, const CSVData& rows) {
+    if (!enabled() || !key.cacheable()) {
+        return;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.bytes = sizeof(Entry) + approximateResultBytes(rows);
+    if (entry.bytes > capacityBytes) {
+        return;
+    }
+    entry.rows = rows;
+    insert(std::move(entry));
+}
+
+
+void ResultCache::putAggregate(const ResultCacheKey& key, const RangeAggregate& aggregate) {
+    if (!enabled() || !key.cacheable()) {
+        return;
+    }
+    Entry entry;
+    entry.key = key;
+    entry.aggregate = aggregate;
+    entry.bytes = sizeof(Entry);
+    insert(std::move(entry));
+}
+
+
+void ResultCache::invalidate(double time) {
+    for (auto it = lru.begin(); it != lru.end();) {
+        auto next = std::next(it);
+        if (it->key.startTime <= time && time <= it->key.endTime) {
+            counters.invalidations++;
+            erase(it);
+        }
+        it = next;
+    }
+}
+
+
+void ResultCache::invalidate(const std::vector<double>& sortedTimes) {
+    if (sortedTimes.empty()) {
+        return;
+    }
+    for (auto it = lru.begin(); it != lru.end();) {
+        auto next = std::next(it);
+        auto first = std::lower_bound(sortedTimes.begin(), sortedTimes.end(), it->key.startTime);
+        if (first != sortedTimes.end() && *first <= it->key.endTime) {
+            counters.invalidations++;
+            erase(it);
+        }
+        it = next;
+    }
+}
+
+
+void ResultCache::clear() {
+    lru.clear();
+    entries.clear();
+    usedBytes = 0;
+}
+
+
+ResultCacheStats ResultCache::stats() const {
+    ResultCacheStats result = counters;
+    result.entries = entries.size();
+    result.bytes = usedBytes;
+    result.capacity = capacityBytes;
+    return result;
+}
+
+
+void ResultCache::insert(Entry entry) {
+    auto existing = entries.find(entry.key);
+    if (existing != entries.end()) {
+        erase(existing->second);
+    }
+
+    usedBytes += entry.bytes;
+    lru.push_front(std::move(entry));
+    entries[lru.front().key] = lru.begin();
+    evictToCapacity();
+}
+
+
+void ResultCache::erase(EntryList::iterator it) {
+    usedBytes -= it->bytes;
+    entries.erase(it->key);
+    lru.erase(it);
+}
+
+
+void ResultCache::evictToCapacity() {
+    while (!lru.empty() && usedBytes > capacityBytes) {
+        counters.evictions++;
+        erase(std::prev(lru.end()));
+    }
+}
@@ -0,0 +1,282 @@
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+
+#include "../include/internal/rollup.hpp"
+#include "../include/internal/faultinjection.hpp"
+
+// Continuous aggregates.
+// Buckets are maintained incrementally on append/delete and persisted
+// next to the main file, so rollup queries never scan the raw rows.
+
+namespace {
+
+const std::vector<std::string> kAggregates = {"count", "sum", "mean", "min", "max"};
+
+
+std::vector<std::string> splitList(const std::string& value, char delimiter) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+std::string joinList(const std::vector<std::string>& items, char delimiter) {
+    std::string out;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0) {
+            out += delimiter;
+        }
+        out += items[i];
+    }
+    return out;
+}
+
+}  // namespace
+
+
+Rollup makeRollup(const RollupSpec& spec, const std::vector<std::string>& headers) {
+    if (spec.name.empty() || spec.name.find_first_of(",\n") != std::string::npos) {
+        throw std::invalid_argument("Rollup name must be non-empty and must not contain ',' or newlines");
+    }
+    if (!(spec.bucketWidth > 0.0) || !std::isfinite(spec.bucketWidth)) {
+        throw std::invalid_argument("Rollup bucket width must be a positive number");
+    }
+    if (spec.columns.empty() || spec.aggregates.empty()) {
+        throw std::invalid_argument("Rollup needs at least one column and one aggregate");
+    }
+
+    Rollup rollup;
+    rollup.spec = spec;
+
+    for (const auto& aggregate : spec.aggregates) {
+        if (std::find(kAggregates.begin(), kAggregates.end(), aggregate) == kAggregates.end()) {
+            throw std::invalid_argument("Unsupported rollup aggregate: " + aggregate);
+        }
+    }
+
+    for (const auto& column : spec.columns) {
+        int position = findColumn(headers, column);
+        if (position < 0) {
+            throw std::invalid_argument("Unknown rollup column: " + column);
+        }
+        rollup.columnIndices.push_back(position);
+    }
+
+    return rollup;
+}
+
+
+bool sameRollupSpec(const RollupSpec& a, const RollupSpec& b) {
+    return a.name == b.name && a.bucketWidth == b.bucketWidth &&
+           a.columns == b.columns && a.aggregates == b.aggregates;
+}
+
+
+double rollupBucketStart(const Rollup& rollup, double time) {
+    return std::floor(time / rollup.spec.bucketWidth) * rollup.spec.bucketWidth;
+}
+
+
+void rollupAdd(Rollup& rollup, const Point& point) {
+    RollupBucket& bucket = rollup.buckets[rollupBucketStart(rollup, point.time)];
+    if (bucket.cells.empty()) {
+        bucket.cells.resize(rollup.columnIndices.size());
+    }
+
+    bucket.points++;
+    for (size_t c = 0; c < rollup.columnIndices.size(); ++c) {
+        int position = rollup.columnIndices[c];
+        double value;
+        if (position >= static_cast<int>(point.rows.size()) || !numericValue(point.rows[position], value)) {
+            continue;
+        }
+
+        RollupCell& cell = bucket.cells[c];
+        cell.count++;
+        cell.sum += value;
+        cell.min = std::min(cell.min, value);
+        cell.max = std::max(cell.max, value);
+    }
+}
+
+
+void rollupRemove(Rollup& rollup, const Point& point) {
+    auto it = rollup.buckets.find(rollupBucketStart(rollup, point.time));
+    if (it == rollup.buckets.end()) {
+        return;
+    }
+
+    RollupBucket& bucket = it->second;
+    if (--bucket.points <= 0) {
+        rollup.buckets.erase(it);
+        return;
+    }
+
+    for (size_t c = 0; c < rollup.columnIndices.size(); ++c) {
+        int position = rollup.columnIndices[c];
+        double value;
+        if (position >= static_cast<int>(point.rows.size()) || !numericValue(point.rows[position], value)) {
+            continue;
+        }
+
+        RollupCell& cell = bucket.cells[c];
+        cell.count--;
+        cell.sum -= value;
+
+        // min/max cannot be decremented, rescan the bucket before the next query.
+        if (value <= cell.min || value >= cell.max) {
+            bucket.stale = true;
+        }
+    }
+}
+
+
+void rollupRebuildBucket(Rollup& rollup, double bucketStart, const std::vector<const Point*>& points) {
+    rollup.buckets.erase(bucketStart);
+    for (const Point* point : points) {
+        rollupAdd(rollup, *point);
+    }
+}
+
+
+CSVData queryRollup(const Rollup& rollup, double startTime, double endTime) {
+    CSVData result;
+    result.headers.push_back("time");
+    for (const auto& column : rollup.spec.columns) {
+        for (const auto& aggregate : rollup.spec.aggregates) {
+            result.headers.push_back(column + "_" + aggregate);
+        }
+    }
+
+    // Include the bucket that contains startTime.
+    auto it = rollup.buckets.lower_bound(rollupBucketStart(rollup, startTime));
+    for (; it != rollup.buckets.end() && it->first <= endTime; ++it) {
+        const RollupBucket& bucket = it->second;
+
+        Point point;
+        point.time = it->first;
+        for (const auto& cell : bucket.cells) {
+            for (const auto& aggregate : rollup.spec.aggregates) {
+                if (aggregate == "count") {
+                    point.rows.push_back({static_cast<int>(cell.count)});
+                } else if (aggregate == "sum") {
+                    point.rows.push_back({cell.sum});
+                } else if (aggregate == "mean") {
+                    point.rows.push_back({cell.count > 0 ? cell.sum / cell.count : std::nan("")});
+                } else if (aggregate == "min") {
+                    point.rows.push_back({cell.count > 0 ? cell.min : std::nan("")});
+                } else {
+                    point.rows.push_back({cell.count > 0 ? cell.max : std::nan("")});
+                }
+            }
+        }
+        result.points.push_back(point);
+    }
+
+    return result;
+}
+
+
+// Rollup file format, one record per line:
+//   rollup,<name>,<bucketWidth>,<col;col>,<agg;agg>
+//   bucket,<start>,<points>,<count>,<sum>,<min>,<max>[,<count>,<sum>,<min>,<max>...]
+// Bucket lines belong to the preceding rollup line.
+void writeRollups(const std::string& filename, const std::vector<Rollup>& rollups) {
+    std::ostringstream file;
+    file << std::setprecision(17);
+    for (const auto& rollup : rollups) {
+        file << "rollup," << rollup.spec.name << "," << rollup.spec.bucketWidth << ","
+             << joinList(rollup.spec.columns, ';') << "," << joinList(rollup.spec.aggregates, ';') << "\n";
+
+        for (const auto& [start, bucket] : rollup.buckets) {
+            file << "bucket," << start << "," << bucket.points;
+            for (const auto& cell : bucket.cells) {
+                file << "," << cell.count << "," << cell.sum << "," << cell.min << "," << cell.max;
+            }
+            file << "\n";
+        }
+    }
+
+    std::string text = file.str();
+    std::string tmpFilename = filename + ".tmp";
+    std::ofstream out(tmpFilename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open rollup file");
+    }
+
+    size_t length = text.size();
+    FaultAction action = injectFault(FaultSite::Write, tmpFilename, &length);
+    if (action != FaultAction::Fail) {
+        out.write(text.data(), static_cast<std::streamsize>(length));
+    }
+    out.flush();
+    bool success = out.good() && action != FaultAction::Fail;
+    out.close();
+
+    if (action == FaultAction::Torn) {
+        crashAfterTornWrite(tmpFilename);
+    }
+    if (!success) {
+        throw std::runtime_error("Failed to write rollup file");
+    }
+    if (injectFault(FaultSite::Rename, filename) == FaultAction::Fail) {
+        throw std::runtime_error("Failed to replace rollup file");
+    }
+    std::filesystem::rename(tmpFilename, filename);
+}
+
+
+std::vector<Rollup> readRollups(const std::string& filename, const std::vector<std::string>& headers) {
+    std::vector<Rollup> rollups;
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return rollups;
+    }
+
+    std::string line;
+    while (std::getline(file, line)) {
+        auto fields = splitList(line, ',');
+        if (fields.empty()) {
+            continue;
+        }
+
+        if (fields[0] == "rollup" && fields.size() == 5) {
+            RollupSpec spec;
+            spec.name = fields[1];
+            spec.bucketWidth = std::stod(fields[2]);
+            spec.columns = splitList(fields[3], ';');
+            spec.aggregates = splitList(fields[4], ';');
+            rollups.push_back(makeRollup(spec, headers));
+        } else if (fields[0] == "bucket" && !rollups.empty()) {
+            Rollup& rollup = rollups.back();
+            size_t columns = rollup.columnIndices.size();
+            if (fields.size() != 3 + 4 * columns) {
+                throw std::runtime_error("Malformed bucket in rollup file");
+            }
+
+            RollupBucket bucket;
+            bucket.points = std::stoll(fields[2]);
+            for (size_t c = 0; c < columns; ++c) {
+                RollupCell cell;
+                cell.count = std::stoll(fields[3 + 4 * c]);
+                cell.sum = std::stod(fields[4 + 4 * c]);
+                cell.min = std::stod(fields[5 + 4 * c]);
+                cell.max = std::stod(fields[6 + 4 * c]);
+                bucket.cells.push_back(cell);
+            }
+            rollup.buckets[std::stod(fields[1])] = bucket;
+        } else {
+            throw std::runtime_error("Malformed rollup file");
+        }
+    }
+
+    return rollups;
+}
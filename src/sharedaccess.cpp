@@ -0,0 +1,159 @@
+#include <cerrno>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "../include/internal/sharedaccess.hpp"
+
+#ifdef _WIN32
+    #include <io.h>
+    #include <fcntl.h>
+    #include <share.h>
+    #include <sys/stat.h>
+    #include <cstdio>
+#else
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/file.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#endif
+
+// Writer lock and read-only mappings.
+// On POSIX the lock is a flock on the lock file. The file is removed while
+// the lock is still held, so a process that opened it just before and locks
+// it right after finds it unlinked and retries with a fresh file.
+// On Windows an exclusive open of the lock file is the lock.
+
+
+WriterLock::~WriterLock() {
+    release();
+}
+
+
+bool WriterLock::acquire(const std::string& lockPath) {
+    if (held()) {
+        return true;
+    }
+
+#ifdef _WIN32
+    int handle = -1;
+    if (_sopen_s(&handle, lockPath.c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _SH_DENYRW, _S_IREAD | _S_IWRITE) != 0) {
+        if (errno == EACCES) {
+            return false;
+        }
+        throw std::runtime_error("Could not open lock file " + lockPath);
+    }
+    this->fd = handle;
+    this->path = lockPath;
+    return true;
+#else
+    for (int attempt = 0; attempt < 16; ++attempt) {
+        int handle = ::open(lockPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+        if (handle < 0) {
+            throw std::runtime_error("Could not open lock file " + lockPath);
+        }
+        if (::flock(handle, LOCK_EX | LOCK_NB) != 0) {
+            int error = errno;
+            ::close(handle);
+            if (error == EWOULDBLOCK) {
+                return false;
+            }
+            throw std::runtime_error("Could not lock " + lockPath);
+        }
+
+        // Locked, but only counts if the file is still the one at `lockPath`
+        struct stat opened;
+        struct stat current;
+        if (::fstat(handle, &opened) == 0 && ::stat(lockPath.c_str(), &current) == 0 &&
+            opened.st_dev == current.st_dev && opened.st_ino == current.st_ino) {
+            this->fd = handle;
+            this->path = lockPath;
+            return true;
+        }
+        ::close(handle);
+    }
+    return false;
+#endif
+}
+
+
+void WriterLock::release() {
+    if (!held()) {
+        return;
+    }
+#ifdef _WIN32
+    _close(this->fd);
+    std::remove(this->path.c_str());
+#else
+    ::unlink(this->path.c_str());
+    ::close(this->fd);
+#endif
+    this->fd = -1;
+    this->path.clear();
+}
+
+
+bool WriterLock::held() const {
+    return this->fd >= 0;
+}
+
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+
+bool MappedFile::open(const std::string& filePath) {
+    close();
+
+#ifndef _WIN32
+    int handle = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (handle < 0) {
+        return false;
+    }
+    struct stat info;
+    if (::fstat(handle, &info) != 0) {
+        ::close(handle);
+        return false;
+    }
+    if (info.st_size == 0) {
+        ::close(handle);
+        return true;
+    }
+
+    // The mapping pins the file, even if it is replaced by a rename meanwhile
+    void* address = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, handle, 0);
+    ::close(handle);
+    if (address != MAP_FAILED) {
+        this->data = static_cast<const char*>(address);
+        this->size = static_cast<size_t>(info.st_size);
+        this->mapped = true;
+        return true;
+    }
+#endif
+
+    std::ifstream file(filePath, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+    std::stringstream contents;
+    contents << file.rdbuf();
+    this->buffer = contents.str();
+    this->data = this->buffer.data();
+    this->size = this->buffer.size();
+    return true;
+}
+
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (this->mapped) {
+        ::munmap(const_cast<char*>(this->data), this->size);
+    }
+#endif
+    this->data = nullptr;
+    this->size = 0;
+    this->mapped = false;
+    this->buffer.clear();
+}
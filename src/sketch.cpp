@@ -0,0 +1,517 @@
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+
+#include "../include/internal/sketch.hpp"
+#include "../include/internal/faultinjection.hpp"
+
+// Approximate query sketches.
+// The t-digest follows Dunning's merging variant: centroids are merged in
+// mean order as long as the k1 scale function allows, which keeps them small
+// near the tails and accurate for extreme quantiles.
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+constexpr size_t kRegisters = size_t(1) << HyperLogLog::PRECISION;
+
+
+// k1 scale function and its inverse.
+double scaleK(double q, double compression) {
+    return compression / (2.0 * kPi) * std::asin(2.0 * q - 1.0);
+}
+
+
+double scaleQ(double k, double compression) {
+    if (k >= compression / 4.0) {
+        return 1.0;
+    }
+    return (std::sin(k * 2.0 * kPi / compression) + 1.0) / 2.0;
+}
+
+
+// SplitMix64 finalizer, spreads the bits of a weak hash.
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+
+int leadingZeros(uint64_t x) {
+    int zeros = 0;
+    for (uint64_t bit = uint64_t(1) << 63; bit != 0 && (x & bit) == 0; bit >>= 1) {
+        zeros++;
+    }
+    return zeros;
+}
+
+
+std::vector<std::string> splitList(const std::string& value, char delimiter) {
+    std::vector<std::string> items;
+    std::stringstream ss(value);
+    std::string item;
+    while (std::getline(ss, item, delimiter)) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+std::string joinList(const std::vector<std::string>& items, char delimiter) {
+    std::string out;
+    for (size_t i = 0; i < items.size(); ++i) {
+        if (i > 0) {
+            out += delimiter;
+        }
+        out += items[i];
+    }
+    return out;
+}
+
+
+void blockAdd(const Sketches& sketches, SketchBlock& block, const Point& point) {
+    block.points++;
+    block.minTime = std::min(block.minTime, point.time);
+    block.maxTime = std::max(block.maxTime, point.time);
+    if (block.dirty) {
+        return;  // Rebuilt from the rows anyway
+    }
+
+    for (size_t c = 0; c < sketches.columnIndices.size(); ++c) {
+        int position = sketches.columnIndices[c];
+        if (position >= static_cast<int>(point.rows.size())) {
+            continue;
+        }
+        double value;
+        if (numericValue(point.rows[position], value)) {
+            block.digests[c].add(value);
+        }
+        block.distinct[c].add(hashCell(point.rows[position]));
+    }
+}
+
+
+SketchBlock emptyBlock(const Sketches& sketches, double startTime) {
+    SketchBlock block;
+    block.startTime = startTime;
+    block.digests.resize(sketches.columns.size());
+    block.distinct.resize(sketches.columns.size());
+    return block;
+}
+
+}  // namespace
+
+
+TDigest::TDigest(double compression) : compression(compression) {}
+
+
+void TDigest::add(double value, double weight) {
+    if (std::isnan(value) || !(weight > 0.0)) {
+        return;
+    }
+    buffer.push_back({value, weight});
+    totalWeight += weight;
+    minValue = std::min(minValue, value);
+    maxValue = std::max(maxValue, value);
+    if (buffer.size() >= static_cast<size_t>(8 * compression)) {
+        compress();
+    }
+}
+
+
+void TDigest::merge(const TDigest& other) {
+    if (other.totalWeight == 0.0) {
+        return;
+    }
+    buffer.insert(buffer.end(), other.merged.begin(), other.merged.end());
+    buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+    totalWeight += other.totalWeight;
+    minValue = std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    if (buffer.size() >= static_cast<size_t>(8 * compression)) {
+        compress();
+    }
+}
+
+
+void TDigest::compress() {
+    if (buffer.empty()) {
+        return;
+    }
+    buffer.insert(buffer.end(), merged.begin(), merged.end());
+    std::sort(buffer.begin(), buffer.end(),
+        [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+
+    // Grow the current centroid while its quantile range stays within one
+    // unit of the scale function
+    std::vector<Centroid> result;
+    Centroid current = buffer[0];
+    double before = 0.0;  // Weight of the centroids left of `current`
+    double limit = scaleQ(scaleK(0.0, compression) + 1.0, compression);
+    for (size_t i = 1; i < buffer.size(); ++i) {
+        const Centroid& next = buffer[i];
+        if ((before + current.weight + next.weight) / totalWeight <= limit) {
+            current.weight += next.weight;
+            current.mean += (next.mean - current.mean) * next.weight / current.weight;
+        } else {
+            result.push_back(current);
+            before += current.weight;
+            limit = scaleQ(scaleK(before / totalWeight, compression) + 1.0, compression);
+            current = next;
+        }
+    }
+    result.push_back(current);
+
+    merged = std::move(result);
+    buffer.clear();
+}
+
+
+double TDigest::quantile(double q) {
+    compress();
+    if (merged.empty()) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    q = std::clamp(q, 0.0, 1.0);
+    if (merged.size() == 1) {
+        return minValue + q * (maxValue - minValue);
+    }
+
+    // Interpolate between centroid centers, and towards min/max outside them
+    double index = q * totalWeight;
+    const Centroid& first = merged.front();
+    if (index < first.weight / 2.0) {
+        if (first.weight <= 1.0) {
+            return minValue;
+        }
+        return minValue + index / (first.weight / 2.0) * (first.mean - minValue);
+    }
+
+    double center = first.weight / 2.0;
+    for (size_t i = 0; i + 1 < merged.size(); ++i) {
+        double gap = (merged[i].weight + merged[i + 1].weight) / 2.0;
+        if (index < center + gap) {
+            double t = (index - center) / gap;
+            return std::clamp(merged[i].mean + t * (merged[i + 1].mean - merged[i].mean), minValue, maxValue);
+        }
+        center += gap;
+    }
+
+    const Centroid& last = merged.back();
+    if (last.weight <= 1.0) {
+        return maxValue;
+    }
+    double t = std::min((index - center) / (last.weight / 2.0), 1.0);
+    return std::clamp(last.mean + t * (maxValue - last.mean), minValue, maxValue);
+}
+
+
+void TDigest::restore(double min, double max, std::vector<Centroid> centroids) {
+    merged = std::move(centroids);
+    buffer.clear();
+    totalWeight = 0.0;
+    for (const auto& centroid : merged) {
+        totalWeight += centroid.weight;
+    }
+    minValue = min;
+    maxValue = max;
+}
+
+
+HyperLogLog::HyperLogLog() : registers(kRegisters, 0) {}
+
+
+void HyperLogLog::add(uint64_t hash) {
+    size_t index = static_cast<size_t>(hash >> (64 - PRECISION));
+    // Rank of the first set bit in the remaining bits, the guard bit caps it
+    uint64_t rest = (hash << PRECISION) | (uint64_t(1) << (PRECISION - 1));
+    uint8_t rank = static_cast<uint8_t>(leadingZeros(rest) + 1);
+    registers[index] = std::max(registers[index], rank);
+}
+
+
+void HyperLogLog::merge(const HyperLogLog& other) {
+    for (size_t i = 0; i < kRegisters; ++i) {
+        registers[i] = std::max(registers[i], other.registers[i]);
+    }
+}
+
+
+double HyperLogLog::estimate() const {
+    double m = static_cast<double>(kRegisters);
+    double sum = 0.0;
+    size_t zeros = 0;
+    for (uint8_t rank : registers) {
+        sum += std::ldexp(1.0, -rank);
+        zeros += rank == 0 ? 1 : 0;
+    }
+
+    double alpha = 0.7213 / (1.0 + 1.079 / m);
+    double estimate = alpha * m * m / sum;
+    // Linear counting while many registers are still empty
+    if (estimate <= 2.5 * m && zeros > 0) {
+        estimate = m * std::log(m / static_cast<double>(zeros));
+    }
+    return estimate;
+}
+
+
+std::string HyperLogLog::toHex() const {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(2 * kRegisters);
+    for (uint8_t rank : registers) {
+        hex += digits[rank >> 4];
+        hex += digits[rank & 0xf];
+    }
+    return hex;
+}
+
+
+bool HyperLogLog::fromHex(const std::string& hex) {
+    if (hex.size() != 2 * kRegisters) {
+        return false;
+    }
+    auto digit = [](char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < kRegisters; ++i) {
+        int high = digit(hex[2 * i]);
+        int low = digit(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        registers[i] = static_cast<uint8_t>(high << 4 | low);
+    }
+    return true;
+}
+
+
+uint64_t hashCell(const PointRow& cell) {
+    // The variant index keeps e.g. 1 and true apart
+    uint64_t tag = static_cast<uint64_t>(cell.data.index() + 1) * 0x9e3779b97f4a7c15ULL;
+    if (std::holds_alternative<std::string>(cell.data)) {
+        const auto& text = std::get<std::string>(cell.data);
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (unsigned char c : text) {
+            hash ^= c;
+            hash *= 0x100000001b3ULL;
+        }
+        return mix64(hash ^ tag);
+    }
+    if (std::holds_alternative<double>(cell.data)) {
+        double value = std::get<double>(cell.data);
+        value = value == 0.0 ? 0.0 : value;  // -0.0 == 0.0
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        return mix64(bits ^ tag);
+    }
+    if (std::holds_alternative<int>(cell.data)) {
+        return mix64(static_cast<uint64_t>(static_cast<int64_t>(std::get<int>(cell.data))) ^ tag);
+    }
+    return mix64(static_cast<uint64_t>(std::get<bool>(cell.data)) ^ tag);
+}
+
+
+Sketches makeSketches(const std::vector<std::string>& columns, const std::vector<std::string>& headers) {
+    Sketches sketches;
+    if (columns.empty()) {
+        // Every column but time
+        for (size_t i = 1; i < headers.size(); ++i) {
+            sketches.columns.push_back(headers[i]);
+        }
+    } else {
+        sketches.columns = columns;
+    }
+
+    for (const auto& column : sketches.columns) {
+        if (column.find_first_of(",;\n") != std::string::npos) {
+            throw std::invalid_argument("Sketch column names must not contain ',', ';' or newlines");
+        }
+        int position = findColumn(headers, column);
+        if (position < 0) {
+            throw std::invalid_argument("Unknown column: " + column);
+        }
+        sketches.columnIndices.push_back(position);
+    }
+    return sketches;
+}
+
+
+size_t sketchBlockFor(const Sketches& sketches, double time) {
+    auto it = std::upper_bound(sketches.blocks.begin(), sketches.blocks.end(), time,
+        [](double value, const SketchBlock& block) { return value < block.startTime; });
+    return it == sketches.blocks.begin() ? 0 : static_cast<size_t>(it - sketches.blocks.begin()) - 1;
+}
+
+
+void sketchAdd(Sketches& sketches, const Point& point) {
+    if (sketches.blocks.empty()) {
+        sketches.blocks.push_back(emptyBlock(sketches, -std::numeric_limits<double>::infinity()));
+    }
+
+    // New points past a full last block open the next one
+    size_t index = sketchBlockFor(sketches, point.time);
+    if (index + 1 == sketches.blocks.size() && sketches.blocks[index].points >= SKETCH_BLOCK_POINTS &&
+        point.time > sketches.blocks[index].maxTime) {
+        sketches.blocks.push_back(emptyBlock(sketches, point.time));
+        index++;
+    }
+
+    SketchBlock& block = sketches.blocks[index];
+    blockAdd(sketches, block, point);
+    if (block.points > 2 * SKETCH_BLOCK_POINTS) {
+        block.dirty = true;  // Split by the next rebuild
+    }
+}
+
+
+void sketchRemove(Sketches& sketches, double time) {
+    if (sketches.blocks.empty()) {
+        return;
+    }
+    SketchBlock& block = sketches.blocks[sketchBlockFor(sketches, time)];
+    block.points--;
+    block.dirty = true;
+}
+
+
+std::vector<SketchBlock> buildSketchBlocks(const Sketches& sketches, double startTime,
+                                           const std::vector<const Point*>& points) {
+    std::vector<SketchBlock> blocks;
+    if (points.empty()) {
+        return blocks;
+    }
+
+    // Evenly sized blocks of SKETCH_BLOCK_POINTS to 2 * SKETCH_BLOCK_POINTS points
+    size_t count = std::max<size_t>(1, points.size() / SKETCH_BLOCK_POINTS);
+    for (size_t b = 0; b < count; ++b) {
+        size_t begin = points.size() * b / count;
+        size_t end = points.size() * (b + 1) / count;
+        blocks.push_back(emptyBlock(sketches, b == 0 ? startTime : points[begin]->time));
+        for (size_t i = begin; i < end; ++i) {
+            blockAdd(sketches, blocks.back(), *points[i]);
+        }
+        for (auto& digest : blocks.back().digests) {
+            digest.compress();
+        }
+    }
+    return blocks;
+}
+
+
+bool sketchBlockCovered(const SketchBlock& block, double startTime, double endTime) {
+    return !block.dirty && startTime <= block.minTime && block.maxTime <= endTime;
+}
+
+
+void writeSketches(const std::string& filename, Sketches& sketches) {
+    std::ostringstream file;
+    file << std::setprecision(17);
+    file << "sketches," << joinList(sketches.columns, ';') << "\n";
+    for (auto& block : sketches.blocks) {
+        if (block.dirty) {
+            throw std::logic_error("Dirty sketch blocks must be rebuilt before writing");
+        }
+        file << "block," << block.startTime << "," << block.points << ","
+             << block.minTime << "," << block.maxTime << "\n";
+        for (size_t c = 0; c < sketches.columns.size(); ++c) {
+            TDigest& digest = block.digests[c];
+            digest.compress();
+            file << "digest," << digest.min() << "," << digest.max();
+            for (const auto& centroid : digest.centroids()) {
+                file << "," << centroid.mean << "," << centroid.weight;
+            }
+            file << "\nhll," << block.distinct[c].toHex() << "\n";
+        }
+    }
+
+    std::string text = file.str();
+    std::string tmpFilename = filename + ".tmp";
+    std::ofstream out(tmpFilename);
+    if (!out.is_open()) {
+        throw std::runtime_error("Could not open sketch file");
+    }
+
+    size_t length = text.size();
+    FaultAction action = injectFault(FaultSite::Write, tmpFilename, &length);
+    if (action != FaultAction::Fail) {
+        out.write(text.data(), static_cast<std::streamsize>(length));
+    }
+    out.flush();
+    bool success = out.good() && action != FaultAction::Fail;
+    out.close();
+
+    if (action == FaultAction::Torn) {
+        crashAfterTornWrite(tmpFilename);
+    }
+    if (!success) {
+        throw std::runtime_error("Failed to write sketch file");
+    }
+    if (injectFault(FaultSite::Rename, filename) == FaultAction::Fail) {
+        throw std::runtime_error("Failed to replace sketch file");
+    }
+    std::filesystem::rename(tmpFilename, filename);
+    sketches.persistedBlocks = sketches.blocks.size();
+}
+
+
+Sketches readSketches(const std::string& filename, const std::vector<std::string>& headers) {
+    Sketches sketches;
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        return sketches;
+    }
+
+    std::string line;
+    if (!std::getline(file, line) || line.rfind("sketches,", 0) != 0) {
+        throw std::runtime_error("Malformed sketch file");
+    }
+    sketches = makeSketches(splitList(line.substr(9), ';'), headers);
+    size_t columns = sketches.columns.size();
+
+    while (std::getline(file, line)) {
+        auto fields = splitList(line, ',');
+        if (fields.size() != 5 || fields[0] != "block") {
+            throw std::runtime_error("Malformed block in sketch file");
+        }
+        SketchBlock block = emptyBlock(sketches, std::stod(fields[1]));
+        block.points = std::stoll(fields[2]);
+        block.minTime = std::stod(fields[3]);
+        block.maxTime = std::stod(fields[4]);
+
+        for (size_t c = 0; c < columns; ++c) {
+            std::string hll;
+            if (!std::getline(file, line) || !std::getline(file, hll)) {
+                throw std::runtime_error("Truncated sketch file");
+            }
+            auto digest = splitList(line, ',');
+            if (digest.size() < 3 || digest.size() % 2 == 0 || digest[0] != "digest") {
+                throw std::runtime_error("Malformed digest in sketch file");
+            }
+            std::vector<TDigest::Centroid> centroids;
+            for (size_t i = 3; i < digest.size(); i += 2) {
+                centroids.push_back({std::stod(digest[i]), std::stod(digest[i + 1])});
+            }
+            block.digests[c].restore(std::stod(digest[1]), std::stod(digest[2]), std::move(centroids));
+
+            if (hll.rfind("hll,", 0) != 0 || !block.distinct[c].fromHex(hll.substr(4))) {
+                throw std::runtime_error("Malformed distinct sketch in sketch file");
+            }
+        }
+        sketches.blocks.push_back(std::move(block));
+    }
+
+    sketches.persistedBlocks = sketches.blocks.size();
+    return sketches;
+}
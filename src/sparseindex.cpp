@@ -0,0 +1,452 @@
+#include <atomic>
+#include <cmath>
+#include <iomanip>
+#include <algorithm>
+#include <filesystem>
+#include <limits>
+#include <random>
+#include <string_view>
+
+#include "../include/internal/sparseindex.hpp"
+#include "../include/internal/codec.hpp"
+#include "../include/internal/parallel.hpp"
+#include "../include/internal/faultinjection.hpp"
+
+// Sparse index sidecar.
+// The data file is kept sorted by time, so a handful of (time, offset) pairs
+// is enough to split it into independent blocks. Open validates the sidecar
+// against the data file and parses the blocks in parallel; any mismatch falls
+// back to the full parse in parseCSV.
+
+namespace {
+
+using HeaderReader = csv2::Reader<csv2::delimiter<','>,
+                                  csv2::quote_character<'"'>,
+                                  csv2::first_row_is_header<true>,
+                                  csv2::trim_policy::trim_whitespace>;
+
+using RowReader = csv2::Reader<csv2::delimiter<','>,
+                               csv2::quote_character<'"'>,
+                               csv2::first_row_is_header<false>,
+                               csv2::trim_policy::trim_whitespace>;
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ULL;
+constexpr uint64_t kFnvPrime = 1099511628211ULL;
+const char* const kMagic = "stampdb-index,1";
+
+
+uint64_t fnv1a(const char* data, size_t size, uint64_t hash = kFnvOffset) {
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= kFnvPrime;
+    }
+    return hash;
+}
+
+
+// Checksum of the header line and the last block. Appends and rewrites
+// always touch the end of the file, header changes mean a different schema.
+bool checksumDataFile(std::string_view data, const SparseIndex& index, uint64_t& out) {
+    uint64_t tailStart = index.entries.empty() ? index.headerSize : index.entries.back().offset;
+    if (index.headerSize > data.size() || index.dataSize > data.size() || tailStart > index.dataSize) {
+        return false;
+    }
+    uint64_t hash = fnv1a(data.data(), index.headerSize);
+    out = fnv1a(data.data() + tailStart, index.dataSize - tailStart, hash);
+    return true;
+}
+
+
+bool isBlankLine(const std::string& line) {
+    return line.find_first_not_of(" \t\r") == std::string::npos;
+}
+
+}  // namespace
+
+
+SparseIndex buildSparseIndex(const std::string& dataFilename, const SparseIndex* previous, uint64_t stride) {
+    if (stride == 0) {
+        throw std::invalid_argument("Sparse index stride must be positive");
+    }
+
+    std::ifstream file(dataFilename, std::ios::binary);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open data file " + dataFilename);
+    }
+
+    SparseIndex index;
+    index.stride = stride;
+
+    // Readers tell appends from replaced files by the epoch
+    if (previous != nullptr) {
+        index.epoch = previous->epoch;
+    } else {
+        std::random_device device;
+        index.epoch = (static_cast<uint64_t>(device()) << 32) ^ device();
+    }
+
+    uint64_t offset = 0;
+    uint64_t row = 0;
+    double lastTime = -std::numeric_limits<double>::infinity();
+    std::string line;
+
+    if (previous != nullptr && previous->stride == stride && !previous->entries.empty()) {
+        // Rows before the last block did not change, rescan from there.
+        index.headerSize = previous->headerSize;
+        index.entries.assign(previous->entries.begin(), previous->entries.end() - 1);
+        offset = previous->entries.back().offset;
+        row = previous->entries.back().row;
+        if (!index.entries.empty()) {
+            lastTime = index.entries.back().time;
+        }
+        file.seekg(static_cast<std::streamoff>(offset));
+    } else {
+        if (!std::getline(file, line)) {
+            throw std::runtime_error("Data file has no header: " + dataFilename);
+        }
+        index.headerSize = line.size() + (file.eof() ? 0 : 1);
+        offset = index.headerSize;
+    }
+
+    while (std::getline(file, line)) {
+        uint64_t lineSize = line.size() + (file.eof() ? 0 : 1);
+
+        if (!isBlankLine(line)) {
+            const char* begin = line.c_str();
+            char* end = nullptr;
+            double time = std::strtod(begin, &end);
+            if (end == begin) {
+                throw std::runtime_error("Invalid time value in row " + std::to_string(row));
+            }
+            if (time < lastTime) {
+                throw std::runtime_error("Data file is not sorted by time");
+            }
+            lastTime = time;
+
+            if (row % stride == 0) {
+                index.entries.push_back({time, offset, row});
+            }
+            row++;
+        }
+
+        offset += lineSize;
+    }
+
+    index.rowCount = row;
+    index.dataSize = offset;
+    MappedFile mapped;
+    if (!mapped.open(dataFilename) || !checksumDataFile(mapped.view(), index, index.dataChecksum)) {
+        throw std::runtime_error("Could not checksum data file " + dataFilename);
+    }
+    return index;
+}
+
+
+bool validateSparseIndex(const SparseIndex& index, const std::string& dataFilename, bool allowGrowth) {
+    MappedFile mapped;
+    return mapped.open(dataFilename) && validateSparseIndex(index, mapped, allowGrowth);
+}
+
+
+bool validateSparseIndex(const SparseIndex& index, const MappedFile& data, bool allowGrowth) {
+    uint64_t size = data.view().size();
+    if (size < index.dataSize || (!allowGrowth && size != index.dataSize) || index.stride == 0 ||
+        index.headerSize > index.dataSize) {
+        return false;
+    }
+
+    // Entry layout: one entry every `stride` rows, offsets and times in order.
+    if (index.entries.size() != (index.rowCount + index.stride - 1) / index.stride) {
+        return false;
+    }
+    for (size_t i = 0; i < index.entries.size(); ++i) {
+        const auto& entry = index.entries[i];
+        if (entry.row != i * index.stride || entry.offset < index.headerSize || entry.offset >= index.dataSize) {
+            return false;
+        }
+        if (i > 0 && (entry.offset <= index.entries[i - 1].offset || entry.time < index.entries[i - 1].time)) {
+            return false;
+        }
+    }
+
+    uint64_t checksum;
+    return checksumDataFile(data.view(), index, checksum) && checksum == index.dataChecksum;
+}
+
+
+// Sidecar file format, one record per line:
+//   stampdb-index,1
+//   generation,<generation>
+//   epoch,<epoch>
+//   data,<stride>,<dataSize>,<rowCount>,<headerSize>,<dataChecksum>
+//   entry,<time>,<offset>,<row>
+//   checksum,<FNV-1a of all preceding bytes>
+void writeSparseIndex(const std::string& filename, const SparseIndex& index) {
+    std::ostringstream out;
+    out << std::setprecision(17);
+    out << kMagic << "\n";
+    out << "generation," << index.generation << "\n";
+    out << "epoch," << index.epoch << "\n";
+    out << "data," << index.stride << "," << index.dataSize << "," << index.rowCount << ","
+        << index.headerSize << "," << index.dataChecksum << "\n";
+    for (const auto& entry : index.entries) {
+        out << "entry," << entry.time << "," << entry.offset << "," << entry.row << "\n";
+    }
+
+    std::string text = out.str();
+    text += "checksum," + std::to_string(fnv1a(text.data(), text.size())) + "\n";
+
+    std::string tmpFilename = filename + ".tmp";
+    std::ofstream file(tmpFilename, std::ios::binary | std::ios::trunc);
+    if (!file.is_open()) {
+        throw std::runtime_error("Could not open sparse index file");
+    }
+
+    size_t length = text.size();
+    FaultAction action = injectFault(FaultSite::Write, tmpFilename, &length);
+    if (action != FaultAction::Fail) {
+        file.write(text.data(), static_cast<std::streamsize>(length));
+    }
+    file.flush();
+    bool success = file.good() && action != FaultAction::Fail;
+    file.close();
+
+    if (action == FaultAction::Torn) {
+        crashAfterTornWrite(tmpFilename);
+    }
+    if (!success) {
+        throw std::runtime_error("Failed to write sparse index file");
+    }
+    if (injectFault(FaultSite::Rename, filename) == FaultAction::Fail) {
+        throw std::runtime_error("Failed to replace sparse index file");
+    }
+    std::filesystem::rename(tmpFilename, filename);
+}
+
+
+bool readSparseIndex(const std::string& filename, SparseIndex& index) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    std::string text = buffer.str();
+
+    // The last line holds the checksum of everything before it.
+    size_t checksumLine = text.rfind("checksum,");
+    if (checksumLine == std::string::npos || (checksumLine > 0 && text[checksumLine - 1] != '\n') ||
+        text.find('\n', checksumLine) + 1 != text.size()) {
+        return false;
+    }
+
+    SparseIndex loaded;
+    try {
+        if (std::stoull(text.substr(checksumLine + 9)) != fnv1a(text.data(), checksumLine)) {
+            return false;
+        }
+
+        std::istringstream lines(text.substr(0, checksumLine));
+        std::string line;
+        if (!std::getline(lines, line) || line != kMagic) {
+            return false;
+        }
+
+        while (std::getline(lines, line)) {
+            std::vector<std::string> fields;
+            std::stringstream ss(line);
+            std::string field;
+            while (std::getline(ss, field, ',')) {
+                fields.push_back(field);
+            }
+
+            if (fields.size() == 2 && fields[0] == "generation") {
+                loaded.generation = std::stoull(fields[1]);
+            } else if (fields.size() == 2 && fields[0] == "epoch") {
+                loaded.epoch = std::stoull(fields[1]);
+            } else if (fields.size() == 6 && fields[0] == "data") {
+                loaded.stride = std::stoull(fields[1]);
+                loaded.dataSize = std::stoull(fields[2]);
+                loaded.rowCount = std::stoull(fields[3]);
+                loaded.headerSize = std::stoull(fields[4]);
+                loaded.dataChecksum = std::stoull(fields[5]);
+            } else if (fields.size() == 4 && fields[0] == "entry") {
+                loaded.entries.push_back({std::stod(fields[1]), std::stoull(fields[2]), std::stoull(fields[3])});
+            } else {
+                return false;
+            }
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    index = std::move(loaded);
+    return true;
+}
+
+
+bool parseCSVWithSparseIndex(const std::string& filename, const SparseIndex& index,
+                             const std::vector<ColumnType>& types, CSVData& csv,
+                             FullIndex& dbIndex, int threads) {
+    MappedFile mapped;
+    return mapped.open(filename) && parseCSVWithSparseIndex(mapped, index, types, csv, dbIndex, threads);
+}
+
+
+bool parseCSVWithSparseIndex(const MappedFile& data, const SparseIndex& index,
+                             const std::vector<ColumnType>& types, CSVData& csv,
+                             FullIndex& dbIndex, int threads) {
+    if (data.view().size() < index.dataSize) {
+        return false;
+    }
+    // Rows past `dataSize` are not committed yet
+    std::string_view buffer = data.view().substr(0, index.dataSize);
+
+    CSVData loaded;
+    loaded.types = types;
+
+    // headers
+    HeaderReader headerReader;
+    headerReader.parse_view(std::string_view(buffer.data(), index.headerSize));
+    for (const auto& header : headerReader.header()) {
+        std::string value;
+        header.read_value(value);
+        loaded.headers.push_back(value);
+    }
+
+    if (!types.empty() && types.size() + 1 != loaded.headers.size()) {
+        throw std::invalid_argument("Schema does not match the number of columns of the data file");
+    }
+
+    std::vector<std::string> cells;
+    std::unique_ptr<RowCodec> codec;
+    if (!types.empty() || index.entries.empty()) {
+        codec = makeRowCodec(types);
+    } else {
+        // Infer the column types from the first row, like parseCSV.
+        size_t begin = index.entries.front().offset;
+        size_t end = buffer.find('\n', begin);
+        RowReader firstRow;
+        firstRow.parse_view(buffer.substr(begin, (end == std::string_view::npos ? buffer.size() : end) - begin));
+        for (const auto& row : firstRow) {
+            readRowCells(row, cells);
+            break;
+        }
+        if (cells.empty()) {
+            return false;
+        }
+        codec = makeRowCodec(inferColumnTypes({cells.begin() + 1, cells.end()}));
+        loaded.types = codec->types();
+    }
+
+    FullIndex fullIndex;
+    fullIndex.MAX_ROWNUM = static_cast<int>(index.rowCount);
+    fullIndex.indices.resize(index.rowCount);
+    loaded.points.resize(index.rowCount);
+
+    // Each block fills its own slice of points and indices.
+    std::atomic<bool> matches{true};
+    try {
+        parallelForMorsels(index.entries.size(), threads, 1, [&](size_t first, size_t last, int) {
+            std::vector<std::string> blockCells;
+            for (size_t b = first; b < last && matches.load(std::memory_order_relaxed); ++b) {
+                const auto& entry = index.entries[b];
+                bool hasNext = b + 1 < index.entries.size();
+                uint64_t blockEnd = hasNext ? index.entries[b + 1].offset : index.dataSize;
+                uint64_t rowEnd = std::min(entry.row + index.stride, index.rowCount);
+
+                RowReader reader;
+                reader.parse_view(buffer.substr(entry.offset, blockEnd - entry.offset));
+
+                uint64_t row = entry.row;
+                double lastTime = entry.time;
+                bool ok = true;
+                for (const auto& csvRow : reader) {
+                    if (csvRow.length() < loaded.headers.size()) {
+                        continue;  // Blank line, also skipped by buildSparseIndex
+                    }
+                    if (row >= rowEnd) {
+                        ok = false;
+                        break;
+                    }
+
+                    readRowCells(csvRow, blockCells);
+                    Point& point = loaded.points[row];
+                    codec->parse(blockCells, point);
+
+                    if (point.time < lastTime || (row == entry.row && point.time != entry.time)) {
+                        ok = false;
+                        break;
+                    }
+                    lastTime = point.time;
+
+                    fullIndex.indices[row].time = point.time;
+                    fullIndex.indices[row].index = static_cast<int>(row);
+                    row++;
+                }
+
+                if (!ok || row != rowEnd || (hasNext && lastTime > index.entries[b + 1].time)) {
+                    matches.store(false, std::memory_order_relaxed);
+                }
+            }
+        });
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    if (!matches.load()) {
+        return false;
+    }
+
+    csv = std::move(loaded);
+    dbIndex = std::move(fullIndex);
+    return true;
+}
+
+
+bool parseAppendedRows(const MappedFile& data, const SparseIndex& previous, const SparseIndex& index,
+                       const RowCodec& codec, size_t columns, std::vector<Point>& points) {
+    // An append keeps the header and every entry but the last, which it may extend
+    if (index.epoch != previous.epoch || index.stride != previous.stride ||
+        index.headerSize != previous.headerSize || index.dataSize < previous.dataSize ||
+        index.rowCount < previous.rowCount || index.entries.size() < previous.entries.size() ||
+        data.view().size() < index.dataSize) {
+        return false;
+    }
+    for (size_t i = 0; i + 1 < previous.entries.size(); ++i) {
+        const auto& before = previous.entries[i];
+        const auto& after = index.entries[i];
+        if (before.time != after.time || before.offset != after.offset || before.row != after.row) {
+            return false;
+        }
+    }
+
+    std::vector<Point> appended;
+    appended.reserve(index.rowCount - previous.rowCount);
+    std::vector<std::string> cells;
+    RowReader reader;
+    reader.parse_view(data.view().substr(previous.dataSize, index.dataSize - previous.dataSize));
+    try {
+        for (const auto& csvRow : reader) {
+            if (csvRow.length() < columns) {
+                continue;  // Blank line, also skipped by buildSparseIndex
+            }
+            readRowCells(csvRow, cells);
+            Point point;
+            codec.parse(cells, point);
+            if (!appended.empty() && point.time < appended.back().time) {
+                return false;
+            }
+            appended.push_back(std::move(point));
+        }
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    if (appended.size() != index.rowCount - previous.rowCount) {
+        return false;
+    }
+    points = std::move(appended);
+    return true;
+}
@@ -1,168 +1,1279 @@
 #include "../include/stampdb.hpp"
 
-StampDB::StampDB(const std::string& filename) : filename(filename), shadowFilename(filename + ".tmp"), operationCount(0) {
-    // Load data using existing parseCSV function and initialize index
-    this->data = parseCSV(filename, this->dbIndex);
-    
-    // Create shadow copy using existing file I/O functions
-    createShadowCopy(filename);
+StampDB::StampDB(const std::string& filename) : StampDB(filename, std::vector<std::string>{}) {}
+
+StampDB::StampDB(const std::string& filename, const std::vector<std::string>& schema, OpenMode mode) : filename(filename),
+    shadowFilename(filename + ".tmp"), rollupFilename(filename + ".rollups"),
+    indexFilename(filename + ".idx"), sketchFilename(filename + ".sketch"), lockFilename(filename + ".lock"),
+    mode(mode), operationCount(0), persistedMaxTime(-std::numeric_limits<double>::infinity()) {
+    for (const auto& name : schema) {
+        this->schemaTypes.push_back(columnTypeFromName(name));
+    }
+
+    if (mode == OpenMode::ReadWrite && !this->writerLock.acquire(lockFilename)) {
+        throw std::runtime_error("Database " + filename + " is already open for writing in another process");
+    }
+    load();
+}
+
+void StampDB::load() {
+    const auto& types = this->schemaTypes;
+    bool readOnly = this->mode == OpenMode::ReadOnly;
+
+    // Open through the sparse index when it still matches the data file: the
+    // file is known to be sorted, so blocks are parsed in parallel straight into
+    // the full index. Otherwise parse the whole file and write a fresh index.
+    // Without a schema, column types are inferred from the first row.
+    MappedFile mapped;
+    auto loadIndexed = [&]() {
+        // Readers stop at the last commit, the writer may be appending past it
+        if (!readSparseIndex(indexFilename, this->sparseIndex) || !mapped.open(filename) ||
+            !validateSparseIndex(this->sparseIndex, mapped, true)) {
+            return false;
+        }
+        if (!readOnly && mapped.view().size() != this->sparseIndex.dataSize) {
+            // Appends go straight to the data file. An append interrupted by a
+            // crash can leave a partial row behind the last indexed commit; cut
+            // it only now that the index is known to describe this file.
+            mapped.close();
+            truncatePartialTail(filename, this->sparseIndex.dataSize);
+            if (!mapped.open(filename) || !validateSparseIndex(this->sparseIndex, mapped)) {
+                return false;
+            }
+        }
+        return parseCSVWithSparseIndex(mapped, this->sparseIndex, types, this->data,
+                                       this->dbIndex, resolveThreadCount(0));
+    };
+    bool loaded = loadIndexed();
+
+    // While a writer has the database open, only its published index tells a
+    // reader where the last commit ends. The writer may be between replacing
+    // the file and publishing the new index: retry for a moment, then refuse.
+    for (int attempt = 0; !loaded && readOnly && std::filesystem::exists(lockFilename); ++attempt) {
+        if (attempt == 50) {
+            throw std::runtime_error("Database " + filename + " has no published index matching its data file");
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        loaded = loadIndexed();
+    }
+    mapped.close();
+    if (loaded) {
+        this->hasSparseIndex = true;
+    } else {
+        this->data = parseCSV(filename, this->dbIndex, types);
+        if (!readOnly && std::filesystem::exists(filename)) {
+            persistSparseIndex(false);
+        }
+    }
+    this->codec = makeRowCodec(this->data.types);
+    if (!this->dbIndex.indices.empty()) {
+        this->persistedMaxTime = this->dbIndex.indices.back().time;
+    }
+
+    // Load persisted rollups. Rollups that do not cover exactly the rows on disk
+    // (e.g. deletions that were never compacted) are rebuilt from the data.
+    try {
+        this->rollups = readRollups(rollupFilename, this->data.headers);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Ignoring unreadable rollup file: " << e.what() << std::endl;
+        this->rollups.clear();
+    }
+    for (auto& rollup : this->rollups) {
+        long long covered = 0;
+        for (const auto& [start, bucket] : rollup.buckets) {
+            covered += bucket.points;
+        }
+        if (covered != static_cast<long long>(this->data.points.size())) {
+            rebuildRollup(rollup);
+        }
+    }
+
+    // Load persisted sketches. Rows appended after the last sketched one are
+    // added again; if the rows up to it differ from what was sketched, rebuild.
+    try {
+        this->sketches = readSketches(sketchFilename, this->data.headers);
+    } catch (const std::exception& e) {
+        std::cerr << "Warning: Ignoring unreadable sketch file: " << e.what() << std::endl;
+        this->sketches = {};
+    }
+    if (!this->sketches.columns.empty()) {
+        long long covered = 0;
+        for (const auto& block : this->sketches.blocks) {
+            covered += block.points;
+        }
+        double sketchedUntil = this->sketches.blocks.empty() ? -std::numeric_limits<double>::infinity()
+                                                             : this->sketches.blocks.back().maxTime;
+        const auto& indices = this->dbIndex.indices;
+        auto tail = std::upper_bound(indices.begin(), indices.end(), sketchedUntil,
+            [](double time, const Index& idx) { return time < idx.time; });
+        if (tail - indices.begin() == covered) {
+            for (; tail != indices.end(); ++tail) {
+                sketchAdd(this->sketches, this->data.points[tail->index]);
+            }
+        } else {
+            this->sketches.blocks.assign(1, SketchBlock{});
+            this->sketches.blocks[0].dirty = true;
+            refreshSketches();
+        }
+    }
 }
 
-CSVData StampDB::read(double time) {
+StampDB::~StampDB() {
+    stopFlusher();
+}
+
+CSVData StampDB::read(double time, const std::vector<std::string>& columns) {
     CSVData result;
-    result.headers = this->data.headers;
-    
-    // Use findInTimeRange with a zero-width range to find exact time match
-    auto range = findInTimeRange(this->dbIndex, time, time);
-    if (!range.empty()) {
-        result.points.push_back(this->data.points[range[0].index]);
+    read_into(time, result, columns);
+    return result;
+}
+
+void StampDB::read_into(double time, CSVData& result, const std::vector<std::string>& columns) {
+    if (this->hotWindow.read(time, columns, result)) {
+        return;
     }
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    std::vector<int> projection = resolveProjection(this->data.headers, columns);
+    setResultColumns(result, columns.empty() ? nullptr : &projection);
     
-    return result;
+    // Exact time match, without materializing a range
+    const Index* found = findExactTime(this->dbIndex, this->memTable, time);
+    if (found == nullptr) {
+        resizeResult(result, 0);
+        return;
+    }
+
+    // Assigning into existing slots reuses their capacity
+    resizeResult(result, 1);
+    if (columns.empty()) {
+        result.points[0] = this->data.points[found->index];
+    } else {
+        projectPoint(this->data.points[found->index], projection, result.points[0]);
+    }
 }
 
-CSVData StampDB::read_range(double startTime, double endTime) {
+CSVData StampDB::read_range(double startTime, double endTime, int threads, const std::vector<std::string>& columns) {
     CSVData result;
-    result.headers = this->data.headers;
+    read_range_into(startTime, endTime, result, threads, columns);
+    return result;
+}
+
+void StampDB::read_range_into(double startTime, double endTime, CSVData& result, int threads,
+                              const std::vector<std::string>& columns) {
+    if (this->hotWindow.readRange(startTime, endTime, columns, result)) {
+        return;
+    }
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    std::vector<int> projection = resolveProjection(this->data.headers, columns);
+    bool projected = !columns.empty();
+    setResultColumns(result, projected ? &projection : nullptr);
+
+    ResultCacheKey key;
+    key.kind = ResultCacheKey::Range;
+    key.startTime = startTime;
+    key.endTime = endTime;
+    if (projected) {
+        key.columns = result.headers;  // Resolved names, so equivalent projections share entries
+    }
+    if (const CSVData* cached = this->resultCache.findRows(key)) {
+        resizeResult(result, cached->points.size());
+        std::copy(cached->points.begin(), cached->points.end(), result.points.begin());
+        return;
+    }
     
-    auto range = findInTimeRange(this->dbIndex, startTime, endTime);
-    for (const auto& idx : range) {
-        // Skip if index is out of bounds
+    findInTimeRange(this->dbIndex, this->memTable, startTime, endTime, this->rangeScratch);
+    auto& range = this->rangeScratch;
+
+    // Drop invalid indices up front. This should not happen in a consistent index.
+    auto invalid = std::remove_if(range.begin(), range.end(), [this](const Index& idx) {
         if (idx.index < 0 || idx.index >= this->data.points.size()) {
             std::cerr << "Warning: Invalid index " << idx.index << " for time " << idx.time << ". Skipping." << std::endl;
-            continue;
+            return true;
         }
-        result.points.push_back(this->data.points[idx.index]);
+        return false;
+    });
+    range.erase(invalid, range.end());
+
+    // Every morsel fills its own slice of the output. Copy-assigning into
+    // slots left over from a previous query reuses their row and string buffers.
+    // With a projection only the requested cells are copied.
+    resizeResult(result, range.size());
+    parallelForMorsels(range.size(), queryThreads(threads), MORSEL_SIZE,
+        [&](size_t begin, size_t end, int) {
+            for (size_t i = begin; i < end; ++i) {
+                if (projected) {
+                    projectPoint(this->data.points[range[i].index], projection, result.points[i]);
+                } else {
+                    result.points[i] = this->data.points[range[i].index];
+                }
+            }
+        });
+
+    this->resultCache.putRows(key, result);
+}
+
+void StampDB::setResultColumns(CSVData& result, const std::vector<int>* projection) const {
+    if (projection == nullptr) {
+        result.headers = this->data.headers;
+        result.types = this->data.types;
+        return;
     }
-    
+
+    // Time first, then the projected columns in the requested order
+    result.headers.assign(this->data.headers.begin(), this->data.headers.begin() + 1);
+    result.types.clear();
+    for (int position : *projection) {
+        result.headers.push_back(this->data.headers[position + 1]);
+        if (position < static_cast<int>(this->data.types.size())) {
+            result.types.push_back(this->data.types[position]);
+        }
+    }
+    if (result.types.size() != projection->size()) {
+        result.types.clear();
+    }
+}
+
+void StampDB::resizeResult(CSVData& result, size_t size) {
+    auto& points = result.points;
+
+    // Park trimmed points in the pool instead of freeing their buffers
+    while (points.size() > size) {
+        if (this->pointPool.size() < POINT_POOL_CAPACITY) {
+            this->pointPool.push_back(std::move(points.back()));
+        }
+        points.pop_back();
+    }
+
+    points.reserve(size);
+    while (points.size() < size) {
+        if (this->pointPool.empty()) {
+            points.emplace_back();
+        } else {
+            points.push_back(std::move(this->pointPool.back()));
+            this->pointPool.pop_back();
+        }
+    }
+}
+
+int StampDB::queryThreads(int threads) const {
+    return resolveThreadCount(threads == USE_DB_THREADS ? this->THREADS : threads);
+}
+
+RangeAggregate StampDB::aggregate_range(double startTime, double endTime, const std::string& column, int threads) {
+    RangeAggregate hot;
+    if (this->hotWindow.aggregate(startTime, endTime, column, hot)) {
+        return hot;
+    }
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    int position = findColumn(this->data.headers, column);
+    if (position < 0) {
+        throw std::invalid_argument("Unknown column: " + column);
+    }
+
+    ResultCacheKey key;
+    key.kind = ResultCacheKey::Aggregate;
+    key.startTime = startTime;
+    key.endTime = endTime;
+    key.predicate = column;
+    if (const RangeAggregate* cached = this->resultCache.findAggregate(key)) {
+        return *cached;
+    }
+
+    findInTimeRange(this->dbIndex, this->memTable, startTime, endTime, this->rangeScratch);
+    const auto& range = this->rangeScratch;
+
+    // Per-thread partial aggregates, merged once all morsels are done.
+    int workers = queryThreads(threads);
+    std::vector<RangeAggregate> partials(workers);
+    parallelForMorsels(range.size(), workers, MORSEL_SIZE,
+        [&](size_t begin, size_t end, int worker) {
+            RangeAggregate local;
+            for (size_t i = begin; i < end; ++i) {
+                const auto& idx = range[i];
+                if (idx.index < 0 || idx.index >= this->data.points.size()) {
+                    continue;
+                }
+                const auto& rows = this->data.points[idx.index].rows;
+                double value;
+                if (position < static_cast<int>(rows.size()) && numericValue(rows[position], value)) {
+                    local.add(value);
+                }
+            }
+            partials[worker].merge(local);
+        });
+
+    RangeAggregate result;
+    for (const auto& partial : partials) {
+        result.merge(partial);
+    }
+    this->resultCache.putAggregate(key, result);
     return result;
 }
 
+std::vector<int> StampDB::resamplePositions(const std::vector<std::string>& columns) const {
+    std::vector<int> positions;
+    if (columns.empty()) {
+        for (size_t i = 0; i + 1 < this->data.headers.size(); ++i) {
+            if (i >= this->data.types.size() || this->data.types[i] != ColumnType::String) {
+                positions.push_back(static_cast<int>(i));
+            }
+        }
+        return positions;
+    }
+
+    positions = resolveProjection(this->data.headers, columns);
+    for (size_t i = 0; i < positions.size(); ++i) {
+        size_t position = static_cast<size_t>(positions[i]);
+        if (position < this->data.types.size() && this->data.types[position] == ColumnType::String) {
+            throw std::invalid_argument("Column is not numeric: " + this->data.headers[position + 1]);
+        }
+    }
+    return positions;
+}
+
+std::vector<std::string> StampDB::resampleColumns(const std::vector<std::string>& columns) const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    std::vector<std::string> names;
+    for (int position : resamplePositions(columns)) {
+        names.push_back(this->data.headers[position + 1]);
+    }
+    return names;
+}
+
+void StampDB::resample_into(double startTime, double endTime, double step, ResampleMethod method,
+                            const std::vector<std::string>& columns, double* out, int threads) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    size_t size = resampleSize(startTime, endTime, step);
+    std::vector<int> positions = resamplePositions(columns);
+
+    // Late arrivals must be in the index the grid walks
+    mergeMemTable(this->dbIndex, this->memTable);
+
+    // Every morsel of grid rows searches its first row, then walks the index
+    parallelForMorsels(size, queryThreads(threads), MORSEL_SIZE,
+        [&](size_t begin, size_t end, int) {
+            resampleGrid(this->data, this->dbIndex.indices, startTime, step, begin, end, method, positions, out);
+        });
+}
+
 CSVData StampDB::delete_point(double time) {
-    // Find the exact time match
-    auto range = findInTimeRange(this->dbIndex, time, time);
-    
-    if (!range.empty()) {
-        // Delete the point using the found index
-        this->data = deletePointwithIndex(this->data, range[0].index, time, this->dbIndex, this->deletedIndices);
+    ChangeDelivery delivery(this->changeFeed);  // Delivers once the lock below is released
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    if (removePoint(time)) {
+        afterWrite(1, 0);
     }
     
     return this->data;
 }
 
+bool StampDB::removePoint(double time, bool publish) {
+    // Find the exact time match
+    const Index* found = findExactTime(this->dbIndex, this->memTable, time);
+    if (found == nullptr) {
+        return false;
+    }
+
+    int index = found->index;
+    this->lastSeq++;
+    if (publish && this->changeFeed.active()) {
+        this->changeFeed.publish(ChangeKind::Delete, this->lastSeq, this->data.points[index]);
+    }
+    this->resultCache.invalidate(time);
+    this->hotWindow.invalidate(time);
+    for (auto& rollup : this->rollups) {
+        rollupRemove(rollup, this->data.points[index]);
+    }
+    if (!this->sketches.columns.empty()) {
+        sketchRemove(this->sketches, time);
+    }
+
+    // Delete the point using the found index
+    deletePointwithIndex(this->data, index, time, this->dbIndex,
+                         this->memTable, this->newAdded, this->deletedIndices);
+    return true;
+}
+
 bool StampDB::checkpoint() {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    // Late arrivals are merged into the main index in one pass.
+    mergeMemTable(this->dbIndex, this->memTable);
+
     if (this->newAdded.indices.empty()) {
-        return true;  // Nothing to checkpoint
-    }
-    
-    if (!std::filesystem::exists(shadowFilename)) {
-        if (!createShadowCopy(filename)) {
-            throw std::runtime_error("Failed to create initial shadow copy");
+        // Nothing to checkpoint, pending deletions are committed by compact()
+        if (this->deletedIndices.indices.empty() && this->committedSeq != this->lastSeq) {
+            this->committedSeq = this->lastSeq;
+            this->committedCondition.notify_all();
         }
+        return true;
     }
     
-    std::ofstream file = openFileInAppend(shadowFilename);
-    if (!file.is_open()) {
-        throw std::runtime_error("Failed to open shadow file for checkpointing");
+    // Write new points in time order.
+    NewAdded pending = this->newAdded;
+    std::stable_sort(pending.indices.begin(), pending.indices.end(),
+        [](const Index& a, const Index& b) {
+            return a.time < b.time;
+        });
+
+    // Late points fall inside the range already on disk. Appending them would
+    // leave the file unsorted, so merge everything into a sorted rewrite instead.
+    // A point at the last persisted time replaces a deleted row and is rewritten too,
+    // appending it would leave both rows on disk until the next compaction.
+    if (pending.indices.front().time <= this->persistedMaxTime) {
+        rewriteSorted();
+        return true;
     }
-    
-    // Create a temporary CSVData with just the new points
-    CSVData newPoints;
-    newPoints.headers = this->data.headers;
-    
-    // Add all points from newAdded using their indices
-    for (const auto& idx : this->newAdded.indices) {
-        if (idx.index >= 0 && idx.index < static_cast<int>(this->data.points.size())) {
-            newPoints.points.push_back(this->data.points[idx.index]);
-        }
+
+    // In-order points are appended to the data file in one sequential write.
+    // A torn append is cut back to the last complete row on the next open.
+    std::error_code sizeError;
+    uint64_t committedSize = std::filesystem::file_size(this->filename, sizeError);
+    std::unique_ptr<FileWriter> file = openFileInAppend(this->filename, writeOptions());
+    if (!file) {
+        throw std::runtime_error("Failed to open data file for checkpointing");
     }
     
-    bool success = writeToCSV(newPoints, file, this->newAdded);
-    file.flush();
-    file.close();
+    // Stream the new points straight from the in-memory data
+    bool success = writeToCSV(this->data, *file, pending);
+    success = file->close() && success;
 
     if (!success) {
-        throw std::runtime_error("Failed to write checkpoint data to shadow file");
+        // Drop what a failed append left behind, the retry would otherwise
+        // continue a partial row
+        if (!sizeError) {
+            std::error_code error;
+            std::filesystem::resize_file(this->filename, committedSize, error);
+        }
+        throw std::runtime_error("Failed to write checkpoint data to data file");
     }
     
     // Clear newAdded only after successful write
     this->newAdded.indices.clear();
-    
-    if (!swapShadowAsDb(this->filename)) {
-        throw std::runtime_error("Failed to swap shadow file after checkpoint");
+    this->pendingBytes = 0;
+
+    this->persistedMaxTime = pending.indices.back().time;
+    persistRollups();
+    persistSparseIndex(true);
+    persistSketches(false);
+
+    if (this->deletedIndices.indices.empty()) {
+        this->committedSeq = this->lastSeq;
+        this->committedCondition.notify_all();
     }
     
     return true;
 }
 
+void StampDB::rewriteSorted() {
+    mergeMemTable(this->dbIndex, this->memTable);
+    sortPointsByTime(this->data, this->dbIndex);
+
+    // Pending rows moved with the sort. If the rewrite fails they are still
+    // appended by a later checkpoint, so point them at their new slots.
+    for (auto& idx : this->newAdded.indices) {
+        if (const Index* moved = findExactTime(this->dbIndex, this->memTable, idx.time)) {
+            idx.index = moved->index;
+        }
+    }
+
+    // Write the complete, time-ordered data to the shadow file
+    writeCSV(shadowFilename, this->data, writeOptions());
+
+    // Atomically swap the rewritten shadow file with the main database
+    if (!swapShadowAsDb(this->filename)) {
+        throw std::runtime_error("Failed to swap rewritten shadow file");
+    }
+
+    // The data file now holds every pending row and deletion. Update the state
+    // and the sparse index first, so a failed sync below cannot leave rows to be
+    // appended twice or an index of the replaced file to be extended.
+    this->newAdded.indices.clear();
+    this->deletedIndices.indices.clear();
+    this->pendingBytes = 0;
+    this->persistedMaxTime = this->dbIndex.indices.empty()
+        ? -std::numeric_limits<double>::infinity()
+        : this->dbIndex.indices.back().time;
+    persistSparseIndex(false);
+
+    if (this->policy.mode != DurabilityMode::None && !syncDirectory(this->filename)) {
+        throw std::runtime_error("Failed to sync database directory after rewrite");
+    }
+    this->committedSeq = this->lastSeq;
+    this->committedCondition.notify_all();
+    persistRollups();
+    persistSketches(true);
+}
+
 bool StampDB::updatePoint(const Point& point) {
-    // Find the exact time match
-    
-    // This will make this truly append only.
-    this->delete_point(point.time); // This will only delete if the point exists.
-    return this->appendPoint(point); // This will only append if the point does not exist.
+    ChangeDelivery delivery(this->changeFeed);  // Delivers once the lock below is released
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    // Delete and re-append, keeping the file append only. Both halves are
+    // applied before committing, so a failed commit cannot leave the point
+    // deleted but not re-added.
+    int operations = removePoint(point.time, false) ? 1 : 0;
+    size_t bytes = insertPoint(point, operations > 0 ? ChangeKind::Update : ChangeKind::Append);
+    afterWrite(operations + 1, bytes);
+    return true;
 }
 
 bool StampDB::appendPoint(const Point& point) {
+    ChangeDelivery delivery(this->changeFeed);  // Delivers once the lock below is released
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
     // If the point already exists, return false and suggest `update_point` instead
-    auto range = findInTimeRange(this->dbIndex, point.time, point.time);
-    if (!range.empty()) {
+    if (findExactTime(this->dbIndex, this->memTable, point.time) != nullptr) {
         std::cout << "Warning: Point at time " << point.time << " already exists. Use `update_point` instead." << std::endl;
         return false;
     }
 
-    // Add the new point to our in-memory data
-    this->data = appendRow(this->data, point, this->dbIndex, this->newAdded);
-    
-    // Check if we need to perform a checkpoint
-    if (++operationCount >= CHECKPOINT) {
-        checkpoint();
-        operationCount = 0;
-    }
+    size_t bytes = insertPoint(point, ChangeKind::Append);
+
+    // Commit according to the durability policy
+    afterWrite(1, bytes);
     
     return true;
 }
 
+size_t StampDB::insertPoint(const Point& point, ChangeKind kind) {
+    // Store cells with the schema types, so reads and writes can use the typed codec
+    Point typed = point;
+    this->codec->coerce(typed);
+    size_t bytes = approximateRowSize(typed);
+
+    this->lastSeq++;
+    if (this->changeFeed.active()) {
+        this->changeFeed.publish(kind, this->lastSeq, typed);
+    }
+
+    this->resultCache.invalidate(typed.time);
+    for (auto& rollup : this->rollups) {
+        rollupAdd(rollup, typed);
+    }
+    if (!this->sketches.columns.empty()) {
+        sketchAdd(this->sketches, typed);
+    }
+
+    // New points extend the hot window, late ones inside it clear it
+    if (this->dbIndex.indices.empty() || this->dbIndex.indices.back().time < typed.time) {
+        this->hotWindow.push(typed);
+    } else {
+        this->hotWindow.invalidate(typed.time);
+    }
+
+    // Add the new point to our in-memory data
+    appendRow(this->data, std::move(typed), this->dbIndex, this->memTable, this->newAdded);
+
+    // Keep the late-arrival buffer small
+    if (static_cast<int>(this->memTable.indices.size()) >= MEMTABLE_CAPACITY) {
+        mergeMemTable(this->dbIndex, this->memTable);
+    }
+    return bytes;
+}
+
+int StampDB::appendPoints(std::vector<Point> points) {
+    ChangeDelivery delivery(this->changeFeed);  // Delivers once the lock below is released
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    if (points.empty()) {
+        return 0;
+    }
+
+    // Late points already buffered must be part of the index we merge into.
+    mergeMemTable(this->dbIndex, this->memTable);
+
+    for (auto& point : points) {
+        this->codec->coerce(point);
+    }
+
+    std::stable_sort(points.begin(), points.end(),
+        [](const Point& a, const Point& b) {
+            return a.time < b.time;
+        });
+
+    // Drop duplicates inside the batch and points that already exist.
+    size_t skipped = 0;
+    size_t out = 0;
+    for (size_t i = 0; i < points.size(); ++i) {
+        auto existing = findFirstAfterOrEqualTime(this->dbIndex, points[i].time);
+        bool duplicate = (out > 0 && points[out - 1].time == points[i].time) ||
+                         (existing != this->dbIndex.indices.end() && existing->time == points[i].time);
+        if (duplicate) {
+            skipped++;
+            continue;
+        }
+        if (out != i) {
+            points[out] = std::move(points[i]);
+        }
+        out++;
+    }
+    points.resize(out);
+
+    if (skipped > 0) {
+        std::cout << "Warning: Skipped " << skipped << " points with existing times. Use `update_point` instead." << std::endl;
+    }
+
+    if (this->resultCache.enabled()) {
+        std::vector<double> times;
+        times.reserve(points.size());
+        for (const auto& point : points) {
+            times.push_back(point.time);
+        }
+        this->resultCache.invalidate(times);
+    }
+
+    for (auto& rollup : this->rollups) {
+        for (const auto& point : points) {
+            rollupAdd(rollup, point);
+        }
+    }
+    if (!this->sketches.columns.empty()) {
+        for (const auto& point : points) {
+            sketchAdd(this->sketches, point);
+        }
+    }
+
+    // The batch is sorted: late points first, then the ones extending the hot window
+    if (this->hotWindow.enabled()) {
+        double newest = this->dbIndex.indices.empty() ? -std::numeric_limits<double>::infinity()
+                                                      : this->dbIndex.indices.back().time;
+        auto late = std::upper_bound(points.begin(), points.end(), newest,
+            [](double time, const Point& point) { return time < point.time; });
+        if (late != points.begin()) {
+            this->hotWindow.invalidate(std::prev(late)->time);
+        }
+        for (auto it = late; it != points.end(); ++it) {
+            this->hotWindow.push(*it);
+        }
+    }
+
+    int appended = static_cast<int>(points.size());
+    size_t bytes = 0;
+    for (const auto& point : points) {
+        bytes += approximateRowSize(point);
+        this->lastSeq++;
+        if (this->changeFeed.active()) {
+            this->changeFeed.publish(ChangeKind::Append, this->lastSeq, point);
+        }
+    }
+    appendRows(this->data, std::move(points), this->dbIndex, this->newAdded);
+
+    // At most one commit for the whole batch.
+    afterWrite(appended, bytes);
+
+    return appended;
+}
+
 CSVData StampDB::compact() {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
     // First, perform a checkpoint if there are pending writes
     checkpoint();
     
-    // If there are deletions, perform compaction by creating a fresh shadow copy
+    // If there are deletions, perform compaction by rewriting the file in time order
     if (!deletedIndices.indices.empty()) {
-        // Create a new shadow file from the current database state
-        if (!createShadowCopy(filename)) {
-            throw std::runtime_error("Failed to create new shadow copy for compaction");
-        }
-        
-        // Write the compacted data to the new shadow file
-        writeCSV(shadowFilename, this->data);
-        
-        // Atomically swap the compacted shadow file with the main database
-        if (!swapShadowAsDb(this->filename)) {
-            throw std::runtime_error("Failed to swap compacted shadow file");
-        }
-        
-        // Clear the deleted indices after successful compaction
-        this->deletedIndices.indices.clear();
+        rewriteSorted();
     }
     
     return this->data;
 }
 
 void StampDB::close() {
+    // Stop the flusher first, it needs the lock to finish a running commit.
+    stopFlusher();
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+
     // Note: Compaction is now user-controlled, so we don't perform it automatically on close
     // The user should explicitly call compact() if they want to persist changes
-    compact();
+    if (this->mode == OpenMode::ReadWrite) {
+        compact();
+    }
     
     // Clear all data structures
     this->data = {};
     this->dbIndex.indices.clear();
     this->dbIndex.MAX_ROWNUM = 0;
+    this->memTable.indices.clear();
     this->newAdded.indices.clear();
     this->deletedIndices.indices.clear();
+    this->rollups.clear();
+    this->sketches = {};
+    this->pointPool.clear();
+    this->resultCache.clear();
+    this->hotWindow.configure(0, 0.0, {}, {}, {});
+    this->changeFeed.closeAll();
     
     // Clean up the temporary file if it exists
-    if (std::filesystem::exists(shadowFilename)) {
+    if (this->mode == OpenMode::ReadWrite && std::filesystem::exists(shadowFilename)) {
         std::filesystem::remove(shadowFilename);
     }
+    this->writerLock.release();
+}
+
+OpenMode StampDB::openMode() const {
+    return this->mode;
+}
+
+void StampDB::requireWritable() const {
+    if (this->mode == OpenMode::ReadOnly) {
+        throw std::runtime_error("Database " + this->filename + " is open read-only");
+    }
+}
+
+bool StampDB::refresh() {
+    ChangeDelivery delivery(this->changeFeed);  // Delivers once the lock below is released
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    if (this->mode == OpenMode::ReadWrite) {
+        return false;
+    }
+
+    SparseIndex latest;
+    if (!readSparseIndex(indexFilename, latest) ||
+        (latest.generation == this->sparseIndex.generation && latest.epoch == this->sparseIndex.epoch)) {
+        return false;
+    }
+
+    // Appends only extend the file: parse the new rows and add them like the writer did
+    if (this->hasSparseIndex) {
+        MappedFile mapped;
+        std::vector<Point> points;
+        bool appended = mapped.open(filename) && validateSparseIndex(latest, mapped, true) &&
+                        parseAppendedRows(mapped, this->sparseIndex, latest, *this->codec,
+                                          this->data.headers.size(), points);
+        mergeMemTable(this->dbIndex, this->memTable);
+        if (appended && !points.empty() && !this->dbIndex.indices.empty() &&
+            points.front().time <= this->dbIndex.indices.back().time) {
+            appended = false;
+        }
+        if (appended) {
+            for (const auto& point : points) {
+                this->resultCache.invalidate(point.time);
+                for (auto& rollup : this->rollups) {
+                    rollupAdd(rollup, point);
+                }
+                if (!this->sketches.columns.empty()) {
+                    sketchAdd(this->sketches, point);
+                }
+                this->hotWindow.push(point);
+                // Already committed by the writer
+                this->lastSeq++;
+                this->committedSeq = this->lastSeq;
+                if (this->changeFeed.active()) {
+                    this->changeFeed.publish(ChangeKind::Append, this->lastSeq, point);
+                }
+            }
+            if (!points.empty()) {
+                this->persistedMaxTime = points.back().time;
+            }
+            NewAdded committed;  // Already on disk
+            appendRows(this->data, std::move(points), this->dbIndex, committed);
+            this->sparseIndex = std::move(latest);
+            return true;
+        }
+    }
+
+    // Rewritten or not an append of the rows loaded: start over. The updates,
+    // deletions and late points in between are unknown, so the reload takes
+    // one sequence number and subscribers are told they missed changes.
+    this->lastSeq++;
+    this->committedSeq = this->lastSeq;
+    this->changeFeed.disconnectAll(this->lastSeq);
+    this->data = {};
+    this->dbIndex = {};
+    this->memTable.indices.clear();
+    this->rollups.clear();
+    this->sketches = {};
+    this->sparseIndex = {};
+    this->hasSparseIndex = false;
+    this->persistedMaxTime = -std::numeric_limits<double>::infinity();
+    this->resultCache.clear();
+    this->hotWindow.clear();
+    load();
+    return true;
+}
+
+void StampDB::setResultCache(size_t capacityBytes) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    this->resultCache.setCapacity(capacityBytes);
+}
+
+ResultCacheStats StampDB::resultCacheStats() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->resultCache.stats();
+}
+
+void StampDB::setHotWindow(size_t points, double seconds) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    if (seconds < 0.0) {
+        throw std::invalid_argument("Hot window seconds must not be negative");
+    }
+
+    // Seed with the newest points, late arrivals included
+    mergeMemTable(this->dbIndex, this->memTable);
+    std::vector<const Point*> newest;
+    size_t count = std::min(points, this->dbIndex.indices.size());
+    for (size_t i = this->dbIndex.indices.size() - count; i < this->dbIndex.indices.size(); ++i) {
+        newest.push_back(&this->data.points[this->dbIndex.indices[i].index]);
+    }
+    this->hotWindow.configure(points, seconds, this->data.headers, this->data.types, newest);
+}
+
+HotWindowStats StampDB::hotWindowStats() const {
+    return this->hotWindow.stats();
+}
+
+IOOptions StampDB::writeOptions() const {
+    IOOptions options = this->IO;
+    options.sync = this->policy.mode != DurabilityMode::None;
+    return options;
+}
+
+void StampDB::commit() {
+    checkpoint();
+    if (!this->deletedIndices.indices.empty()) {
+        rewriteSorted();
+    }
+}
+
+void StampDB::afterWrite(int operations, size_t bytes) {
+    this->pendingBytes += bytes;
+
+    switch (this->policy.mode) {
+        case DurabilityMode::OpCount:
+            // Check if we need to perform a checkpoint
+            this->operationCount += operations;
+            if (this->operationCount >= CHECKPOINT) {
+                checkpoint();
+                this->operationCount = 0;
+            }
+            break;
+        case DurabilityMode::EveryOpFsync:
+            commit();
+            break;
+        case DurabilityMode::Bytes:
+            if (this->pendingBytes >= this->policy.bytes) {
+                this->flushCondition.notify_all();
+            }
+            break;
+        case DurabilityMode::None:
+        case DurabilityMode::IntervalMs:
+            break;
+    }
+}
+
+void StampDB::setDurability(const DurabilityPolicy& policy) {
+    if (policy.mode == DurabilityMode::IntervalMs && policy.intervalMs <= 0) {
+        throw std::invalid_argument("Durability interval must be positive");
+    }
+    if (policy.mode == DurabilityMode::Bytes && policy.bytes == 0) {
+        throw std::invalid_argument("Durability byte threshold must be positive");
+    }
+
+    stopFlusher();
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    this->policy = policy;
+    this->flushError = nullptr;
+
+    if (policy.mode == DurabilityMode::IntervalMs || policy.mode == DurabilityMode::Bytes) {
+        this->flusherStop = false;
+        this->flusher = std::thread(&StampDB::flusherLoop, this);
+    }
+}
+
+DurabilityPolicy StampDB::durability() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->policy;
+}
+
+uint64_t StampDB::lastSequence() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->lastSeq;
+}
+
+uint64_t StampDB::committedSequence() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->committedSeq;
+}
+
+bool StampDB::waitForCommit(uint64_t sequence, int timeoutMs) {
+    std::unique_lock<std::recursive_mutex> lock(this->mutex);
+    sequence = std::min(sequence, this->lastSeq);
+    if (this->committedSeq >= sequence) {
+        return true;
+    }
+
+    if (!this->flusher.joinable()) {
+        commit();
+        return this->committedSeq >= sequence;
+    }
+
+    this->commitRequested = true;
+    this->flushCondition.notify_all();
+
+    auto done = [this, sequence] {
+        return this->committedSeq >= sequence || this->flushError || this->flusherStop;
+    };
+    if (timeoutMs < 0) {
+        this->committedCondition.wait(lock, done);
+    } else if (!this->committedCondition.wait_for(lock, std::chrono::milliseconds(timeoutMs), done)) {
+        return false;
+    }
+
+    if (this->committedSeq >= sequence) {
+        return true;
+    }
+    if (this->flushError) {
+        std::rethrow_exception(this->flushError);
+    }
+    return false;
+}
+
+std::shared_ptr<ChangeSubscription> StampDB::subscribe(uint64_t fromSeq, size_t capacity,
+                                                       Backpressure backpressure, int blockTimeoutMs) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->changeFeed.subscribe(fromSeq, this->lastSeq, capacity, backpressure, blockTimeoutMs);
+}
+
+void StampDB::setChangeRetention(size_t events) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    this->changeFeed.setRetention(events, this->lastSeq);
+}
+
+void StampDB::flusherLoop() {
+    std::unique_lock<std::recursive_mutex> lock(this->mutex);
+    auto wake = [this] {
+        return this->flusherStop || this->commitRequested ||
+               (this->policy.mode == DurabilityMode::Bytes && this->pendingBytes >= this->policy.bytes);
+    };
+
+    while (!this->flusherStop) {
+        if (this->policy.mode == DurabilityMode::IntervalMs) {
+            this->flushCondition.wait_for(lock, std::chrono::milliseconds(this->policy.intervalMs), wake);
+        } else {
+            this->flushCondition.wait(lock, wake);
+        }
+        if (this->flusherStop) {
+            break;
+        }
+
+        // Everything pending since the last commit goes out as one batch.
+        this->commitRequested = false;
+        if (this->committedSeq == this->lastSeq) {
+            continue;
+        }
+        try {
+            commit();
+            this->flushError = nullptr;
+        } catch (const std::exception& e) {
+            std::cerr << "Warning: Background commit failed: " << e.what() << std::endl;
+            this->flushError = std::current_exception();
+        } catch (...) {
+            this->flushError = std::current_exception();
+        }
+        this->committedCondition.notify_all();
+    }
+}
+
+void StampDB::stopFlusher() {
+    {
+        std::lock_guard<std::recursive_mutex> lock(this->mutex);
+        this->flusherStop = true;
+    }
+    this->flushCondition.notify_all();
+    this->committedCondition.notify_all();
+    if (this->flusher.joinable()) {
+        this->flusher.join();
+    }
+}
+
+Rollup* StampDB::findRollup(const std::string& name) {
+    for (auto& rollup : this->rollups) {
+        if (rollup.spec.name == name) {
+            return &rollup;
+        }
+    }
+    return nullptr;
+}
+
+void StampDB::rebuildRollup(Rollup& rollup) {
+    rollup.buckets.clear();
+    for (const auto& point : this->data.points) {
+        rollupAdd(rollup, point);
+    }
+}
+
+void StampDB::persistRollups() {
+    if (this->rollups.empty() && !std::filesystem::exists(rollupFilename)) {
+        return;
+    }
+    // The stale flag is not persisted, and a reopen only rebuilds rollups whose
+    // point counts differ from the file. Rescan min/max before writing.
+    for (auto& rollup : this->rollups) {
+        if (!rollup.buckets.empty()) {
+            rescanStaleBuckets(rollup, rollup.buckets.begin()->first, rollup.buckets.rbegin()->first);
+        }
+    }
+    writeRollups(rollupFilename, this->rollups);
+}
+
+void StampDB::persistSparseIndex(bool appended) {
+    // The index only speeds up open, failing to write it must not fail the write path.
+    try {
+        SparseIndex index = buildSparseIndex(this->filename,
+            appended && this->hasSparseIndex ? &this->sparseIndex : nullptr);
+        index.generation = this->sparseIndex.generation + 1;
+        writeSparseIndex(indexFilename, index);
+        this->sparseIndex = std::move(index);
+        this->hasSparseIndex = true;
+    } catch (const std::exception& e) {
+        // The last published index stays the readers' manifest: it still
+        // describes a prefix of an appended file, and the next index extends
+        // it. It no longer matches a replaced file, so readers opening it
+        // refuse until a complete index is published.
+        std::cerr << "Warning: Not writing sparse index: " << e.what() << std::endl;
+        if (!appended) {
+            this->hasSparseIndex = false;
+        }
+    }
+}
+
+bool StampDB::addRollup(const RollupSpec& spec) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    Rollup* existing = findRollup(spec.name);
+    if (existing != nullptr && sameRollupSpec(existing->spec, spec)) {
+        return false;  // Already maintained
+    }
+
+    Rollup rollup = makeRollup(spec, this->data.headers);
+    rebuildRollup(rollup);
+
+    if (existing != nullptr) {
+        *existing = std::move(rollup);
+    } else {
+        this->rollups.push_back(std::move(rollup));
+    }
+
+    persistRollups();
+    return true;
+}
+
+bool StampDB::dropRollup(const std::string& name) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    auto it = std::find_if(this->rollups.begin(), this->rollups.end(),
+        [&name](const Rollup& rollup) { return rollup.spec.name == name; });
+    if (it == this->rollups.end()) {
+        return false;
+    }
+
+    this->rollups.erase(it);
+    persistRollups();
+    return true;
+}
+
+CSVData StampDB::read_rollup(const std::string& name, double startTime, double endTime) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    Rollup* rollup = findRollup(name);
+    if (rollup == nullptr) {
+        throw std::invalid_argument("Unknown rollup: " + name);
+    }
+
+    rescanStaleBuckets(*rollup, startTime, endTime);
+    return queryRollup(*rollup, startTime, endTime);
+}
+
+void StampDB::rescanStaleBuckets(Rollup& rollup, double startTime, double endTime) {
+    double width = rollup.spec.bucketWidth;
+    std::vector<double> staleBuckets;
+    auto it = rollup.buckets.lower_bound(rollupBucketStart(rollup, startTime));
+    for (; it != rollup.buckets.end() && it->first <= endTime; ++it) {
+        if (it->second.stale) {
+            staleBuckets.push_back(it->first);
+        }
+    }
+
+    for (double bucketStart : staleBuckets) {
+        std::vector<const Point*> points;
+        for (const auto& idx : findInTimeRange(this->dbIndex, this->memTable, bucketStart, bucketStart + width)) {
+            if (idx.time < bucketStart + width) {
+                points.push_back(&this->data.points[idx.index]);
+            }
+        }
+        rollupRebuildBucket(rollup, bucketStart, points);
+    }
+}
+
+std::vector<RollupSpec> StampDB::rollupSpecs() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    std::vector<RollupSpec> specs;
+    for (const auto& rollup : this->rollups) {
+        specs.push_back(rollup.spec);
+    }
+    return specs;
+}
+
+bool StampDB::enableSketches(const std::vector<std::string>& columns) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    Sketches sketches = makeSketches(columns, this->data.headers);
+    if (sketches.columns.empty()) {
+        throw std::invalid_argument("No columns to sketch");
+    }
+    if (sketches.columns == this->sketches.columns) {
+        return false;  // Already maintained
+    }
+
+    this->sketches = std::move(sketches);
+    this->sketches.blocks.assign(1, SketchBlock{});
+    this->sketches.blocks[0].dirty = true;
+    persistSketches(true);
+    return true;
+}
+
+bool StampDB::dropSketches() {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    requireWritable();
+    if (this->sketches.columns.empty()) {
+        return false;
+    }
+
+    this->sketches = {};
+    std::error_code error;
+    std::filesystem::remove(sketchFilename, error);
+    return true;
+}
+
+std::vector<std::string> StampDB::sketchColumns() const {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    return this->sketches.columns;
+}
+
+std::vector<double> StampDB::approxQuantiles(double startTime, double endTime, const std::string& column,
+                                             const std::vector<double>& quantiles) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    for (double q : quantiles) {
+        if (!(q >= 0.0 && q <= 1.0)) {
+            throw std::invalid_argument("Quantiles must be in [0, 1]");
+        }
+    }
+    size_t index = sketchColumn(column);
+    size_t position = this->sketches.columnIndices[index];
+    if (position < this->data.types.size() && this->data.types[position] == ColumnType::String) {
+        throw std::invalid_argument("Column is not numeric: " + column);
+    }
+
+    TDigest digest;
+    sketchRange(startTime, endTime, index, &digest, nullptr);
+    std::vector<double> result;
+    for (double q : quantiles) {
+        result.push_back(digest.quantile(q));
+    }
+    return result;
+}
+
+double StampDB::approxDistinct(double startTime, double endTime, const std::string& column) {
+    std::lock_guard<std::recursive_mutex> lock(this->mutex);
+    HyperLogLog distinct;
+    sketchRange(startTime, endTime, sketchColumn(column), nullptr, &distinct);
+    return std::round(distinct.estimate());
+}
+
+size_t StampDB::sketchColumn(const std::string& column) const {
+    // Resolved like any other column name, sketched headers keep their CSV spacing
+    int position = findColumn(this->data.headers, column);
+    const auto& indices = this->sketches.columnIndices;
+    auto it = std::find(indices.begin(), indices.end(), position);
+    if (position < 0 || it == indices.end()) {
+        throw std::invalid_argument("Column has no sketch: " + column);
+    }
+    return static_cast<size_t>(it - indices.begin());
+}
+
+void StampDB::sketchRange(double startTime, double endTime, size_t column, TDigest* digest, HyperLogLog* distinct) {
+    const auto& blocks = this->sketches.blocks;
+    if (blocks.empty() || !(startTime <= endTime)) {
+        return;
+    }
+    int position = this->sketches.columnIndices[column];
+
+    // Covered blocks contribute their sketches; rows of the edge blocks and of
+    // dirty blocks are added one by one.
+    for (size_t b = sketchBlockFor(this->sketches, startTime); b < blocks.size() && blocks[b].startTime <= endTime; ++b) {
+        const SketchBlock& block = blocks[b];
+        if (sketchBlockCovered(block, startTime, endTime)) {
+            if (digest != nullptr) {
+                digest->merge(block.digests[column]);
+            }
+            if (distinct != nullptr) {
+                distinct->merge(block.distinct[column]);
+            }
+            continue;
+        }
+
+        double first = std::max(startTime, block.startTime);
+        double last = endTime;
+        if (b + 1 < blocks.size()) {
+            last = std::min(last, std::nextafter(blocks[b + 1].startTime, -std::numeric_limits<double>::infinity()));
+        }
+        findInTimeRange(this->dbIndex, this->memTable, first, last, this->rangeScratch);
+        for (const auto& idx : this->rangeScratch) {
+            const auto& rows = this->data.points[idx.index].rows;
+            if (position >= static_cast<int>(rows.size())) {
+                continue;
+            }
+            double value;
+            if (digest != nullptr && numericValue(rows[position], value)) {
+                digest->add(value);
+            }
+            if (distinct != nullptr) {
+                distinct->add(hashCell(rows[position]));
+            }
+        }
+    }
+}
+
+void StampDB::refreshSketches() {
+    auto& blocks = this->sketches.blocks;
+    mergeMemTable(this->dbIndex, this->memTable);
+
+    std::vector<SketchBlock> refreshed;
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        if (!blocks[b].dirty) {
+            refreshed.push_back(std::move(blocks[b]));
+            continue;
+        }
+
+        double end = b + 1 < blocks.size() ? blocks[b + 1].startTime : std::numeric_limits<double>::infinity();
+        std::vector<const Point*> points;
+        for (auto it = findFirstAfterOrEqualTime(this->dbIndex, blocks[b].startTime);
+             it != this->dbIndex.indices.end() && it->time < end; ++it) {
+            points.push_back(&this->data.points[it->index]);
+        }
+        for (auto& block : buildSketchBlocks(this->sketches, blocks[b].startTime, points)) {
+            refreshed.push_back(std::move(block));
+        }
+    }
+
+    // Emptied blocks were dropped, their range now belongs to the previous block
+    if (!refreshed.empty()) {
+        refreshed.front().startTime = -std::numeric_limits<double>::infinity();
+    }
+    blocks = std::move(refreshed);
+}
+
+void StampDB::persistSketches(bool force) {
+    if (this->sketches.columns.empty()) {
+        return;
+    }
+    bool dirty = std::any_of(this->sketches.blocks.begin(), this->sketches.blocks.end(),
+        [](const SketchBlock& block) { return block.dirty; });
+    if (dirty) {
+        refreshSketches();
+    }
+    // Appends to the last block are recovered on open, only new or rebuilt blocks need a rewrite
+    if (force || dirty || this->sketches.blocks.size() != this->sketches.persistedBlocks) {
+        writeSketches(sketchFilename, this->sketches);
+    }
 }
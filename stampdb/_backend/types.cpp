@@ -7,6 +7,7 @@
 #include "../../include/internal/csvparse.hpp"
 #include "../../include/stampdb.hpp"
 #include "../../include/internal/converter.hpp"
+#include "../../include/internal/faultinjection.hpp"
 
 namespace py = pybind11;
 
@@ -37,6 +38,17 @@ PYBIND11_MODULE(_types, m) {
         });
 
 
+    // MemTable
+    py::class_<MemTable>(m, "MemTable")
+        .def(py::init<>())
+        .def_readwrite("indices", &MemTable::indices)
+        .def("__repr__", [](const MemTable& mt) {
+            std::ostringstream oss;
+            oss << "MemTable(indices=" << mt.indices.size() << " items)";
+            return oss.str();
+        });
+
+
     // NewAdded
     py::class_<NewAdded>(m, "NewAdded")
         .def(py::init<>())
@@ -136,22 +148,347 @@ PYBIND11_MODULE(_types, m) {
             return oss.str();
         });
     
+    // RangeAggregate
+    py::class_<RangeAggregate>(m, "RangeAggregate")
+        .def(py::init<>())
+        .def_readonly("count", &RangeAggregate::count)
+        .def_readonly("sum", &RangeAggregate::sum)
+        .def_readonly("min", &RangeAggregate::min)
+        .def_readonly("max", &RangeAggregate::max)
+        .def("__repr__", [](const RangeAggregate& agg) {
+            std::ostringstream oss;
+            oss << "RangeAggregate(count=" << agg.count << ", sum=" << agg.sum
+                << ", min=" << agg.min << ", max=" << agg.max << ")";
+            return oss.str();
+        });
+
+
+    // RollupSpec
+    py::class_<RollupSpec>(m, "RollupSpec")
+        .def(py::init<>())
+        .def_readwrite("name", &RollupSpec::name)
+        .def_readwrite("bucket_width", &RollupSpec::bucketWidth)
+        .def_readwrite("columns", &RollupSpec::columns)
+        .def_readwrite("aggregates", &RollupSpec::aggregates)
+        .def("__repr__", [](const RollupSpec& spec) {
+            std::ostringstream oss;
+            oss << "RollupSpec(name=\"" << spec.name << "\", bucket_width=" << spec.bucketWidth
+                << ", columns=" << spec.columns.size() << " items"
+                << ", aggregates=" << spec.aggregates.size() << " items)";
+            return oss.str();
+        });
+    
+    // Durability
+    py::enum_<DurabilityMode>(m, "DurabilityMode")
+        .value("OPS", DurabilityMode::OpCount)
+        .value("NONE", DurabilityMode::None)
+        .value("INTERVAL_MS", DurabilityMode::IntervalMs)
+        .value("BYTES", DurabilityMode::Bytes)
+        .value("EVERY_OP_FSYNC", DurabilityMode::EveryOpFsync);
+
+    py::class_<DurabilityPolicy>(m, "DurabilityPolicy")
+        .def(py::init<>())
+        .def_readwrite("mode", &DurabilityPolicy::mode)
+        .def_readwrite("interval_ms", &DurabilityPolicy::intervalMs)
+        .def_readwrite("bytes", &DurabilityPolicy::bytes)
+        .def("__repr__", [](const DurabilityPolicy& policy) {
+            std::ostringstream oss;
+            oss << "DurabilityPolicy(mode=" << static_cast<int>(policy.mode)
+                << ", interval_ms=" << policy.intervalMs << ", bytes=" << policy.bytes << ")";
+            return oss.str();
+        });
+    
+    // I/O backends
+    py::enum_<IOBackendKind>(m, "IOBackendKind")
+        .value("POSIX", IOBackendKind::Posix)
+        .value("IO_URING", IOBackendKind::IoUring);
+
+    py::class_<IOOptions>(m, "IOOptions")
+        .def(py::init<>())
+        .def_readwrite("backend", &IOOptions::backend)
+        .def_readwrite("direct_io", &IOOptions::directIO)
+        .def_readwrite("queue_depth", &IOOptions::queueDepth)
+        .def_readwrite("buffer_size", &IOOptions::bufferSize)
+        .def("__repr__", [](const IOOptions& options) {
+            std::ostringstream oss;
+            oss << "IOOptions(backend=" << (options.backend == IOBackendKind::IoUring ? "io_uring" : "posix")
+                << ", direct_io=" << options.directIO << ", queue_depth=" << options.queueDepth
+                << ", buffer_size=" << options.bufferSize << ")";
+            return oss.str();
+        });
+
+    m.def("io_uring_available", &ioUringAvailable, "True if built with the io_uring backend");
+
+    // Fault injection, for crash-consistency tests
+    py::register_exception<SimulatedCrash>(m, "SimulatedCrash");
+
+    py::enum_<FaultKind>(m, "FaultKind")
+        .value("FAIL", FaultKind::Fail)
+        .value("TORN", FaultKind::Torn)
+        .value("CRASH", FaultKind::Crash);
+
+    m.def("arm_faults", [](uint64_t operation, FaultKind kind, double tornFraction) {
+        FaultPlan plan;
+        plan.operation = operation;
+        plan.kind = kind;
+        plan.tornFraction = tornFraction;
+        armFaults(plan);
+    }, "Fault the given 1-based storage I/O operation, 0 only counts operations",
+       py::arg("operation"), py::arg("kind") = FaultKind::Crash, py::arg("torn_fraction") = 0.5);
+    m.def("disarm_faults", &disarmFaults, "Stop injecting faults and clear the crashed state");
+    m.def("fault_operation_count", &faultOperationCount, "Storage I/O operations since arm_faults");
+    m.def("fault_triggered", &faultTriggered, "True once the planned operation was reached");
+    
+    // ResultCacheStats
+    py::class_<ResultCacheStats>(m, "ResultCacheStats")
+        .def(py::init<>())
+        .def_readonly("hits", &ResultCacheStats::hits)
+        .def_readonly("misses", &ResultCacheStats::misses)
+        .def_readonly("evictions", &ResultCacheStats::evictions)
+        .def_readonly("invalidations", &ResultCacheStats::invalidations)
+        .def_readonly("entries", &ResultCacheStats::entries)
+        .def_readonly("bytes", &ResultCacheStats::bytes)
+        .def_readonly("capacity", &ResultCacheStats::capacity)
+        .def("__repr__", [](const ResultCacheStats& stats) {
+            std::ostringstream oss;
+            oss << "ResultCacheStats(hits=" << stats.hits << ", misses=" << stats.misses
+                << ", entries=" << stats.entries << ", bytes=" << stats.bytes << ")";
+            return oss.str();
+        });
+    
+    // HotWindowStats
+    py::class_<HotWindowStats>(m, "HotWindowStats")
+        .def(py::init<>())
+        .def_readonly("points", &HotWindowStats::points)
+        .def_readonly("oldest_time", &HotWindowStats::oldestTime)
+        .def_readonly("newest_time", &HotWindowStats::newestTime)
+        .def_readonly("hits", &HotWindowStats::hits)
+        .def_readonly("misses", &HotWindowStats::misses)
+        .def_readonly("retired", &HotWindowStats::retired)
+        .def("__repr__", [](const HotWindowStats& stats) {
+            std::ostringstream oss;
+            oss << "HotWindowStats(points=" << stats.points << ", oldest_time=" << stats.oldestTime
+                << ", newest_time=" << stats.newestTime << ", hits=" << stats.hits << ")";
+            return oss.str();
+        });
+    
+    py::enum_<ResampleMethod>(m, "ResampleMethod")
+        .value("LINEAR", ResampleMethod::Linear)
+        .value("PREVIOUS", ResampleMethod::Previous)
+        .value("NULL", ResampleMethod::Null);
+
+    // Record batch in Arrow layout, handed to Arrow consumers through the PyCapsule interface
+    py::class_<ArrowBatch, std::shared_ptr<ArrowBatch>>(m, "ArrowBatch")
+        .def_property_readonly("num_rows", [](const ArrowBatch& self) { return self.length; })
+        .def("__len__", [](const ArrowBatch& self) { return self.length; })
+        .def("__arrow_c_schema__", [](const ArrowBatch& self) { return arrowSchemaCapsule(self); })
+        .def("__arrow_c_array__", [](const std::shared_ptr<ArrowBatch>& self, const py::object&) {
+            return py::make_tuple(arrowSchemaCapsule(*self), arrowArrayCapsule(self));
+        }, py::arg("requested_schema") = py::none())
+        .def("__arrow_c_stream__", [](const std::shared_ptr<ArrowBatch>& self, const py::object&) {
+            return arrowStreamCapsule(self);
+        }, py::arg("requested_schema") = py::none())
+        .def("__repr__", [](const ArrowBatch& self) {
+            return "<ArrowBatch rows=" + std::to_string(self.length) +
+                   " columns=" + std::to_string(self.columns.size()) + ">";
+        });
+
+    py::enum_<ChangeKind>(m, "ChangeKind")
+        .value("APPEND", ChangeKind::Append)
+        .value("UPDATE", ChangeKind::Update)
+        .value("DELETE", ChangeKind::Delete);
+
+    py::enum_<Backpressure>(m, "Backpressure")
+        .value("BLOCK", Backpressure::Block)
+        .value("DISCONNECT", Backpressure::Disconnect);
+
+    // ChangeEvent
+    py::class_<ChangeEvent>(m, "ChangeEvent")
+        .def_readonly("seq", &ChangeEvent::seq)
+        .def_readonly("kind", &ChangeEvent::kind)
+        .def_readonly("point", &ChangeEvent::point)
+        .def_property_readonly("time", [](const ChangeEvent& self) { return self.point.time; })
+        .def_property_readonly("values", [](const ChangeEvent& self) {
+            py::list values;
+            for (const auto& row : self.point.rows) {
+                std::visit([&values](const auto& value) { values.append(value); }, row.data);
+            }
+            return values;
+        })
+        .def("__repr__", [](const ChangeEvent& self) {
+            static const char* kinds[] = {"APPEND", "UPDATE", "DELETE"};
+            std::ostringstream oss;
+            oss << "ChangeEvent(seq=" << self.seq << ", kind=" << kinds[static_cast<int>(self.kind)]
+                << ", time=" << self.point.time << ")";
+            return oss.str();
+        });
+
+    // Subscription to a database's change feed
+    py::class_<ChangeSubscription, std::shared_ptr<ChangeSubscription>>(m, "ChangeSubscription")
+        .def("poll", [](ChangeSubscription& self, size_t maxEvents, int timeoutMs) {
+            std::vector<ChangeEvent> events;
+            {
+                py::gil_scoped_release release;
+                self.poll(events, maxEvents, timeoutMs);
+            }
+            return events;
+        }, "Take up to max_events events, waiting up to timeout_ms for the first one",
+           py::arg("max_events") = 1024, py::arg("timeout_ms") = -1)
+        .def("close", &ChangeSubscription::close, "Stop delivery")
+        .def_property_readonly("closed", &ChangeSubscription::closed)
+        .def_property_readonly("lagged", &ChangeSubscription::lagged)
+        .def_property_readonly("pending", &ChangeSubscription::pending)
+        .def_property_readonly("last_seq", &ChangeSubscription::lastPolled)
+        .def("__repr__", [](const ChangeSubscription& self) {
+            std::ostringstream oss;
+            oss << "<ChangeSubscription last_seq=" << self.lastPolled() << " pending=" << self.pending()
+                << (self.lagged() ? " lagged" : self.closed() ? " closed" : "") << ">";
+            return oss.str();
+        });
+
+    py::enum_<OpenMode>(m, "OpenMode")
+        .value("READ_WRITE", OpenMode::ReadWrite)
+        .value("READ_ONLY", OpenMode::ReadOnly);
+    
     py::class_<StampDB>(m, "StampDB")
         .def(py::init<const std::string&>(), "Constructor with filename")
+        .def(py::init<const std::string&, const std::vector<std::string>&>(), "Constructor with filename and column types")
+        .def(py::init<const std::string&, const std::vector<std::string>&, OpenMode>(),
+             "Constructor with filename, column types and open mode")
         
         // CRUD Operations
-        .def("read", &StampDB::read, "Read data at specific time")
-        .def("read_range", &StampDB::read_range, "Read data in time range")
-        .def("delete_point", &StampDB::delete_point, "Delete point at specific time")
-        .def("append_point", &StampDB::appendPoint, "Append a new point")
-        .def("update_point", &StampDB::updatePoint, "Update an existing point")
+        // Reads release the GIL, so reader threads run next to each other and the writer
+        .def("read", &StampDB::read, "Read data at specific time",
+             py::arg("time"), py::arg("columns") = std::vector<std::string>(),
+             py::call_guard<py::gil_scoped_release>())
+        .def("read_range", &StampDB::read_range, "Read data in time range",
+             py::arg("start_time"), py::arg("end_time"), py::arg("threads") = StampDB::USE_DB_THREADS,
+             py::arg("columns") = std::vector<std::string>(), py::call_guard<py::gil_scoped_release>())
+        .def("read_into", &StampDB::read_into, "Read data at specific time into an existing CSVData",
+             py::arg("time"), py::arg("result"), py::arg("columns") = std::vector<std::string>(),
+             py::call_guard<py::gil_scoped_release>())
+        .def("read_range_into", &StampDB::read_range_into, "Read data in time range into an existing CSVData",
+             py::arg("start_time"), py::arg("end_time"), py::arg("result"), py::arg("threads") = StampDB::USE_DB_THREADS,
+             py::arg("columns") = std::vector<std::string>(), py::call_guard<py::gil_scoped_release>())
+        .def("read_range_arrow", [](StampDB& self, double startTime, double endTime, int threads,
+                                    const std::vector<std::string>& columns) {
+            auto batch = std::make_shared<ArrowBatch>();
+            {
+                py::gil_scoped_release release;
+                CSVData result;
+                self.read_range_into(startTime, endTime, result, threads, columns);
+                *batch = makeArrowBatch(result, threads == StampDB::USE_DB_THREADS ? self.THREADS : threads);
+            }
+            return batch;
+        }, "Read data in time range as an Arrow record batch",
+           py::arg("start_time"), py::arg("end_time"), py::arg("threads") = StampDB::USE_DB_THREADS,
+           py::arg("columns") = std::vector<std::string>())
+        // Writes release the GIL, they may wait for change subscribers to catch up
+        .def("delete_point", &StampDB::delete_point, "Delete point at specific time",
+             py::call_guard<py::gil_scoped_release>())
+        .def("append_point", &StampDB::appendPoint, "Append a new point",
+             py::call_guard<py::gil_scoped_release>())
+        .def("append_points", &StampDB::appendPoints, "Append a batch of points",
+             py::call_guard<py::gil_scoped_release>())
+        .def("append_arrays", [](StampDB& self, py::array times, const py::list& columns) {
+            std::vector<Point> points = convertFromArrays(times, columns);
+            py::gil_scoped_release release;
+            return self.appendPoints(std::move(points));
+        }, "Append points from a time array and one array per column", py::arg("times"), py::arg("columns"))
+        .def("append_arrow", [](StampDB& self, const py::object& source, const std::vector<std::string>& headers,
+                                const std::vector<std::string>& schema) {
+            std::vector<ColumnType> types;
+            for (const auto& name : schema) {
+                types.push_back(columnTypeFromName(name));
+            }
+            std::vector<Point> points = convertFromArrow(source, headers, types);
+            py::gil_scoped_release release;
+            return self.appendPoints(std::move(points));
+        }, "Append the record batches of an Arrow PyCapsule producer", py::arg("source"), py::arg("headers"),
+           py::arg("schema"))
+        .def("update_point", &StampDB::updatePoint, "Update an existing point",
+             py::call_guard<py::gil_scoped_release>())
+        
+        // Aggregations
+        .def("aggregate_range", &StampDB::aggregate_range, "Aggregate a column over a time range",
+             py::arg("start_time"), py::arg("end_time"), py::arg("column"), py::arg("threads") = StampDB::USE_DB_THREADS,
+             py::call_guard<py::gil_scoped_release>())
+        .def("resample", [](StampDB& self, double startTime, double endTime, double step,
+                            ResampleMethod method, const std::vector<std::string>& columns, int threads) {
+            // float64 fields only, so the records are rows of doubles filled in place
+            py::list fields;
+            fields.append(py::make_tuple("time", py::dtype::of<double>()));
+            for (const auto& name : self.resampleColumns(columns)) {
+                fields.append(py::make_tuple(name, py::dtype::of<double>()));
+            }
+            size_t size = resampleSize(startTime, endTime, step);
+            py::array result(py::dtype::from_args(fields), std::vector<py::ssize_t>{static_cast<py::ssize_t>(size)});
+            double* out = static_cast<double*>(result.mutable_data());
+            {
+                py::gil_scoped_release release;
+                self.resample_into(startTime, endTime, step, method, columns, out, threads);
+            }
+            return result;
+        }, "Resample numeric columns onto a regular time grid",
+             py::arg("start_time"), py::arg("end_time"), py::arg("step"), py::arg("method") = ResampleMethod::Linear,
+             py::arg("columns") = std::vector<std::string>(), py::arg("threads") = StampDB::USE_DB_THREADS)
+        
+        // Result cache
+        .def("set_result_cache", &StampDB::setResultCache, "Set the result cache capacity in bytes, 0 disables it")
+        .def("result_cache_stats", &StampDB::resultCacheStats, "Result cache counters")
+        
+        // Hot window
+        .def("set_hot_window", &StampDB::setHotWindow, "Keep the newest points in a lock-free ring, 0 disables it",
+             py::arg("points"), py::arg("seconds") = 0.0)
+        .def("hot_window_stats", &StampDB::hotWindowStats, "Hot window size and counters")
+        
+        // Rollups
+        .def("add_rollup", &StampDB::addRollup, "Add a continuously maintained rollup")
+        .def("drop_rollup", &StampDB::dropRollup, "Drop a rollup")
+        .def("read_rollup", &StampDB::read_rollup, "Read rollup buckets in time range")
+        .def("rollup_specs", &StampDB::rollupSpecs, "Definitions of all rollups")
+        
+        // Approximate queries
+        .def("enable_sketches", &StampDB::enableSketches, "Maintain quantile and distinct count sketches",
+             py::arg("columns") = std::vector<std::string>())
+        .def("drop_sketches", &StampDB::dropSketches, "Drop all sketches")
+        .def("sketch_columns", &StampDB::sketchColumns, "Columns with sketches")
+        .def("approx_quantiles", &StampDB::approxQuantiles, "Approximate quantiles of a column in time range",
+             py::arg("start_time"), py::arg("end_time"), py::arg("column"), py::arg("quantiles"))
+        .def("approx_distinct", &StampDB::approxDistinct, "Approximate distinct count of a column in time range",
+             py::arg("start_time"), py::arg("end_time"), py::arg("column"))
         
         // Database Management
         .def("compact", &StampDB::compact, "Compact the database")
         .def("checkpoint", &StampDB::checkpoint, "Checkpoint the database")
         .def("close", &StampDB::close, "Close the database")
+
+        // Shared access
+        .def_property_readonly("open_mode", &StampDB::openMode)
+        .def("refresh", &StampDB::refresh, "Pick up the writer's new commits in read-only mode",
+             py::call_guard<py::gil_scoped_release>())
+        
+        // Durability
+        .def("set_durability", &StampDB::setDurability, "Set when writes are committed to disk")
+        .def("durability", &StampDB::durability, "Current durability policy")
+        .def("last_sequence", &StampDB::lastSequence, "Sequence number of the last write")
+        .def("committed_sequence", &StampDB::committedSequence, "Sequence number of the last committed write")
+        .def("wait_for_commit", &StampDB::waitForCommit, "Wait until a sequence number is committed",
+             py::arg("sequence"), py::arg("timeout_ms") = -1, py::call_guard<py::gil_scoped_release>())
+
+        // Change feed
+        .def("subscribe", &StampDB::subscribe, "Subscribe to changes after a sequence number",
+             py::arg("from_seq") = LIVE_CHANGES, py::arg("capacity") = 4096, py::arg("backpressure") = Backpressure::Block,
+             py::arg("block_timeout_ms") = 1000)
+        .def("set_change_retention", &StampDB::setChangeRetention, "Retain the last events for late subscribers",
+             py::arg("events"))
         
         // Configuration
         .def_readwrite("CHECKPOINT", &StampDB::CHECKPOINT, "Checkpoint threshold")
+        .def_readwrite("THREADS", &StampDB::THREADS,
+                       "Threads per query, 0 uses all hardware threads. The `threads` argument of a query "
+                       "has the same meaning and overrides it; its default, -1, uses this setting")
+        .def_readwrite("IO", &StampDB::IO, "I/O backend for checkpoint and compaction writes")
+        .def_readwrite("MEMTABLE_CAPACITY", &StampDB::MEMTABLE_CAPACITY, "Late points buffered before merging into the index")
         .def_static("as_numpy_structured_array", &convertToStructuredArray, "Convert CSVData to NumPy structured array");
 }
@@ -3,12 +3,18 @@ from . import _backend
 
 import numpy as np
 import os
-from datetime import datetime, timezone
-from typing import Union, Tuple
+import threading
+from datetime import datetime, timedelta, timezone
+from typing import List, Optional, Sequence, Union, Tuple
 
 from .schema import SchemaValidation
 
 
+def _query_threads(threads: Optional[int]) -> int:
+    """Per-query thread count for the backend, -1 defers to the database setting."""
+    return -1 if threads is None else threads
+
+
 class StampDB:
     """Python wrapper for the StampDB C++ class.
 
@@ -16,20 +22,32 @@ class StampDB:
     time-based indexing and CRUD operations.
     """
 
-    def __init__(self, filename: str, schema: dict = None):
+    def __init__(self, filename: str, schema: dict = None, read_only: bool = False):
         """Initialize StampDB with a CSV file.
 
+        Only one process at a time can open a database for writing. Any number
+        of processes can open it with `read_only=True` next to the writer; they
+        see its commits as of their last call to `refresh`. A read-only open
+        raises RuntimeError if the writer has not published an index that
+        matches the data file, instead of reading rows it has not committed.
+
         Args:
             filename: str
                 Path to the CSV file to use as database storage.
             schema: Optional[dict]
                 Optional dictionary mapping column names to data types.
+            read_only: bool
+                Open an existing database without writing to it.
         """
         self.filename = filename
         self.schema = list(schema.values())
+        self.read_only = read_only
 
         self.schema_file = filename + ".schema"
 
+        if read_only and not os.path.exists(filename):
+            raise ValueError("Database File must exist to open it read-only.")
+
         if os.path.exists(self.schema_file):
             self.schema = SchemaValidation(schema=None, filename=self.schema_file)
         else:
@@ -50,7 +68,13 @@ class StampDB:
             f.write("\n")
             f.close()
 
-        self._db = _backend.StampDB(filename)
+        # Column types select the row codec used to parse and write the file.
+        mode = _backend.OpenMode.READ_ONLY if read_only else _backend.OpenMode.READ_WRITE
+        self._db = _backend.StampDB(filename, self.schema.get_schema(), mode)
+
+        # Reused for every read so steady-state queries do not reallocate rows.
+        # Reads run without the GIL, so every thread gets its own buffer.
+        self._results = threading.local()
 
     def _convert_to_timestamp(self, time: Union[float, datetime]) -> float:
         """Convert datetime object to timestamp if needed.
@@ -67,25 +91,44 @@ class StampDB:
             return time.timestamp()
         return time
 
-    def read(self, time: Union[float, datetime]) -> np.ndarray:
+    @property
+    def _result(self) -> _backend.CSVData:
+        """The calling thread's reusable result buffer."""
+        result = getattr(self._results, "csv", None)
+        if result is None:
+            result = self._results.csv = _backend.CSVData()
+        return result
+
+    def _result_as_numpy(self) -> np.ndarray:
+        """Convert the reusable result buffer to a NumPy structured array."""
+        headers = self._result.headers
+        stripped = [h.strip() for h in headers if h.strip()]
+        if stripped != headers:
+            self._result.headers = stripped
+        return self._db.as_numpy_structured_array(self._result)
+
+    def read(self, time: Union[float, datetime], columns: Sequence[str] = ()) -> np.ndarray:
         """Read data at a specific time.
 
         Args:
             time: Union[float, datetime]
                 The time point to read data from. Can be a Unix timestamp (float) or datetime object.
+            columns: Sequence[str]
+                Columns to read besides time. Empty reads all columns.
 
         Returns:
             NumPy structured array containing the data at the specified time.
         """
         timestamp = self._convert_to_timestamp(time)
-        csv_data = self._db.read(timestamp)
-
-        csv_data.headers = [h.strip() for h in csv_data.headers if h.strip()]
-
-        return self._db.as_numpy_structured_array(csv_data)
+        self._db.read_into(timestamp, self._result, list(columns))
+        return self._result_as_numpy()
 
     def read_range(
-        self, start_time: Union[float, datetime], end_time: Union[float, datetime]
+        self,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+        threads: Optional[int] = None,
+        columns: Sequence[str] = (),
     ) -> np.ndarray:
         """Read data within a time range.
 
@@ -94,17 +137,53 @@ class StampDB:
                 Start of the time range (inclusive). Can be Unix timestamp or datetime object.
             end_time: Union[float, datetime]
                 End of the time range (inclusive). Can be Unix timestamp or datetime object.
+            threads: Optional[int]
+                Threads used for this query, 0 for all hardware threads.
+                None uses the database setting (`threads`).
+            columns: Sequence[str]
+                Columns to read besides time. Only these cells are copied and
+                converted. Empty reads all columns.
 
         Returns:
             NumPy structured array containing all data points within the time range.
         """
         start = self._convert_to_timestamp(start_time)
         end = self._convert_to_timestamp(end_time)
-        csv_data = self._db.read_range(start, end)
+        self._db.read_range_into(start, end, self._result, _query_threads(threads), list(columns))
+        return self._result_as_numpy()
+
+    def read_range_arrow(
+        self,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+        threads: Optional[int] = None,
+        columns: Sequence[str] = (),
+    ):
+        """Read data within a time range as an Arrow record batch.
+
+        The result implements the Arrow PyCapsule interface, so pyarrow, pandas,
+        Polars and DuckDB take it without copying, e.g.
+        `pyarrow.record_batch(batch)` or `polars.from_arrow(batch)`. Strings
+        keep their full length and cells that do not match their column's
+        type are nulls. No Arrow package is needed to produce it.
 
-        csv_data.headers = [h.strip() for h in csv_data.headers if h.strip()]
+        Args:
+            start_time: Union[float, datetime]
+                Start of the time range (inclusive). Can be Unix timestamp or datetime object.
+            end_time: Union[float, datetime]
+                End of the time range (inclusive). Can be Unix timestamp or datetime object.
+            threads: Optional[int]
+                Threads used for this query, 0 for all hardware threads.
+                None uses the database setting (`threads`).
+            columns: Sequence[str]
+                Columns to read besides time. Empty reads all columns.
 
-        return self._db.as_numpy_structured_array(csv_data)
+        Returns:
+            ArrowBatch with a float64 time column and one column per schema column.
+        """
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        return self._db.read_range_arrow(start, end, _query_threads(threads), list(columns))
 
     def delete_point(self, time: Union[float, datetime]) -> np.ndarray:
         """Delete a data point at the specified time.
@@ -136,6 +215,86 @@ class StampDB:
         self.schema.validate(point)
         return self._db.append_point(point.point)
 
+    def append_arrays(self, times, **columns) -> int:
+        """Append many points at once from NumPy arrays (or anything array-like).
+
+        Dtypes are validated against the schema once per column and the raw
+        buffers are handed to the C++ backend, so no per-point Python objects
+        are created.
+
+        Args:
+            times: array-like
+                Times of the points, as floats or `datetime64` values. A structured
+                array with a `time` field and one field per column is accepted
+                as well, in which case no keyword columns are given.
+            **columns: array-like
+                One array per schema column, each with the same length as `times`.
+
+        Returns:
+            Number of points appended. Points whose time already exists are skipped.
+        """
+        times = np.asarray(times)
+        if times.dtype.names is not None and not columns:
+            columns = {name: times[name] for name in times.dtype.names if name != "time"}
+            times = times["time"]
+
+        names = self.headers[1:]
+        if sorted(columns) != sorted(names):
+            raise ValueError(f"Columns {sorted(columns)} do not match schema columns {names}.")
+
+        if np.issubdtype(times.dtype, np.datetime64):
+            times = times.astype("datetime64[ns]").astype(np.int64) / 1e9
+        elif times.dtype.kind not in "fiu":
+            raise ValueError("Times must be numeric or datetime64.")
+
+        arrays = []
+        for name, _type in zip(names, self.schema.get_schema()):
+            values = np.asarray(columns[name])
+            if values.shape != times.shape:
+                raise ValueError(f"Column '{name}' has shape {values.shape}, expected {times.shape}.")
+
+            kind = values.dtype.kind
+            if _type == "float":
+                if kind not in "fiu":
+                    raise ValueError(f"Column '{name}' is not a float column.")
+                values = values.astype(np.float64, copy=False)
+            elif _type == "int":
+                if kind not in "iu":
+                    raise ValueError(f"Column '{name}' is not an integer column.")
+                if values.size and (
+                    values.min() < np.iinfo(np.int32).min
+                    or values.max() > np.iinfo(np.int32).max
+                ):
+                    raise ValueError(f"Column '{name}' does not fit in 32 bit integers.")
+            elif _type == "bool":
+                if kind != "b":
+                    raise ValueError(f"Column '{name}' is not a boolean column.")
+            elif _type == "string":
+                if kind not in "USO":
+                    raise ValueError(f"Column '{name}' is not a string column.")
+            else:
+                raise ValueError(f"Invalid type '{_type}' for column '{name}'.")
+            arrays.append(values)
+
+        return self._db.append_arrays(times.astype(np.float64, copy=False), arrays)
+
+    def append_arrow(self, data) -> int:
+        """Append the rows of Arrow data, read in place from its buffers.
+
+        Accepts any object implementing the Arrow PyCapsule interface, such as
+        pyarrow tables and record batches or Polars data frames. Columns are
+        matched by name. The time column may be numeric or a timestamp; nulls
+        are only allowed in float columns, where they become NaN.
+
+        Args:
+            data: object
+                Object with an `__arrow_c_stream__` or `__arrow_c_array__` method.
+
+        Returns:
+            Number of points appended. Points whose time already exists are skipped.
+        """
+        return self._db.append_arrow(data, self.headers, self.schema.get_schema())
+
     def update_point(self, point: Point) -> bool:
         """Update an existing data point in the database.
 
@@ -149,6 +308,235 @@ class StampDB:
         self.schema.validate(point)
         return self._db.update_point(point.point)
 
+    def aggregate(
+        self,
+        column: str,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+        threads: Optional[int] = None,
+    ) -> dict:
+        """Aggregate a numeric column over a time range in C++.
+
+        Args:
+            column: str
+                Column to aggregate.
+            start_time: Union[float, datetime]
+                Start of the time range (inclusive).
+            end_time: Union[float, datetime]
+                End of the time range (inclusive).
+            threads: Optional[int]
+                Threads used for this query, 0 for all hardware threads.
+                None uses the database setting (`threads`).
+
+        Returns:
+            Dictionary with `count`, `sum`, `mean`, `min` and `max`.
+        """
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        agg = self._db.aggregate_range(start, end, column, _query_threads(threads))
+        empty = agg.count == 0
+        return {
+            "count": agg.count,
+            "sum": agg.sum,
+            "mean": float("nan") if empty else agg.sum / agg.count,
+            "min": float("nan") if empty else agg.min,
+            "max": float("nan") if empty else agg.max,
+        }
+
+    def resample(
+        self,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+        step: Union[float, timedelta],
+        method: str = "linear",
+        columns: Sequence[str] = (),
+        threads: Optional[int] = None,
+    ) -> np.ndarray:
+        """Resample numeric columns onto a regular time grid in C++.
+
+        The grid runs from `start_time` in steps of `step` up to `end_time`.
+        Values are written straight into the result array, gaps are NaN.
+
+        Args:
+            start_time: Union[float, datetime]
+                First grid time.
+            end_time: Union[float, datetime]
+                Last possible grid time (inclusive).
+            step: Union[float, timedelta]
+                Grid spacing, in the same unit as the time column.
+            method: str
+                "linear" interpolates between the neighbouring points,
+                "previous" repeats the last point at or before each grid time,
+                "null" uses the last point within one step and leaves gaps NaN.
+            columns: Sequence[str]
+                Columns to resample. Empty resamples every numeric column.
+            threads: Optional[int]
+                Threads used for this query, 0 for all hardware threads.
+                None uses the database setting (`threads`).
+
+        Returns:
+            NumPy structured array with a `time` field and one float64 field per column.
+        """
+        methods = {
+            "linear": _backend.ResampleMethod.LINEAR,
+            "previous": _backend.ResampleMethod.PREVIOUS,
+            "null": _backend.ResampleMethod.NULL,
+        }
+        if method not in methods:
+            raise ValueError(f"Unknown resample method '{method}', expected one of {list(methods)}.")
+        if isinstance(step, timedelta):
+            step = step.total_seconds()
+        if not step > 0:
+            raise ValueError("step must be positive.")
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        return self._db.resample(start, end, float(step), methods[method], list(columns), _query_threads(threads))
+
+    def add_rollup(
+        self,
+        name: str,
+        bucket_width: float,
+        columns: List[str],
+        aggregates: Sequence[str] = ("count", "sum", "mean", "min", "max"),
+    ) -> bool:
+        """Attach a continuously maintained rollup to the database.
+
+        Buckets are updated on every append, update and delete, and are
+        persisted next to the database file in `<filename>.rollups`.
+
+        Args:
+            name: str
+                Name of the rollup.
+            bucket_width: float
+                Width of each time bucket, in the same unit as the time column.
+            columns: List[str]
+                Columns to aggregate.
+            aggregates: Sequence[str]
+                Any of "count", "sum", "mean", "min" and "max".
+
+        Returns:
+            True if the rollup was created, False if an identical rollup already exists.
+        """
+        spec = _backend.RollupSpec()
+        spec.name = name
+        spec.bucket_width = float(bucket_width)
+        spec.columns = list(columns)
+        spec.aggregates = list(aggregates)
+        return self._db.add_rollup(spec)
+
+    def drop_rollup(self, name: str) -> bool:
+        """Remove a rollup.
+
+        Returns:
+            True if the rollup existed.
+        """
+        return self._db.drop_rollup(name)
+
+    def read_rollup(
+        self,
+        name: str,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+    ) -> np.ndarray:
+        """Read precomputed rollup buckets within a time range.
+
+        Args:
+            name: str
+                Name of the rollup.
+            start_time: Union[float, datetime]
+                Start of the time range (inclusive).
+            end_time: Union[float, datetime]
+                End of the time range (inclusive).
+
+        Returns:
+            NumPy structured array with a `time` field holding the bucket start
+            and one `<column>_<aggregate>` field per aggregate.
+        """
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        csv_data = self._db.read_rollup(name, start, end)
+        return self._db.as_numpy_structured_array(csv_data)
+
+    def enable_sketches(self, columns: Sequence[str] = ()) -> bool:
+        """Maintain sketches for approximate quantile and distinct count queries.
+
+        Rows are grouped into blocks of consecutive times, each with a t-digest
+        and a HyperLogLog per column. Approximate queries merge the sketches of
+        the blocks inside the range and only scan rows at its edges. Sketches are
+        persisted next to the database file in `<filename>.sketch`.
+
+        Args:
+            columns: Sequence[str]
+                Columns to sketch. Empty sketches every column.
+
+        Returns:
+            True if the sketches were created, False if these columns are already sketched.
+        """
+        return self._db.enable_sketches(list(columns))
+
+    def drop_sketches(self) -> bool:
+        """Remove all sketches.
+
+        Returns:
+            True if sketches were enabled.
+        """
+        return self._db.drop_sketches()
+
+    def approx_quantile(
+        self,
+        column: str,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+        q: Union[float, Sequence[float]] = 0.5,
+    ) -> Union[float, List[float]]:
+        """Estimate quantiles of a numeric column within a time range.
+
+        Args:
+            column: str
+                Sketched numeric column.
+            start_time: Union[float, datetime]
+                Start of the time range (inclusive).
+            end_time: Union[float, datetime]
+                End of the time range (inclusive).
+            q: Union[float, Sequence[float]]
+                Quantile or quantiles in [0, 1].
+
+        Returns:
+            The estimated value for each quantile, NaN for an empty range. A
+            single float if `q` is a single quantile.
+        """
+        single = np.isscalar(q)
+        quantiles = [float(q)] if single else [float(value) for value in q]
+        if any(not 0.0 <= value <= 1.0 for value in quantiles):
+            raise ValueError("Quantiles must be in [0, 1].")
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        values = self._db.approx_quantiles(start, end, column, quantiles)
+        return values[0] if single else values
+
+    def approx_distinct(
+        self,
+        column: str,
+        start_time: Union[float, datetime],
+        end_time: Union[float, datetime],
+    ) -> int:
+        """Estimate the number of distinct values of a column within a time range.
+
+        Args:
+            column: str
+                Sketched column.
+            start_time: Union[float, datetime]
+                Start of the time range (inclusive).
+            end_time: Union[float, datetime]
+                End of the time range (inclusive).
+
+        Returns:
+            Estimated distinct count, within a few percent.
+        """
+        start = self._convert_to_timestamp(start_time)
+        end = self._convert_to_timestamp(end_time)
+        return int(self._db.approx_distinct(start, end, column))
+
     def compact(self) -> np.ndarray:
         """Compact the database by removing deleted entries.
 
@@ -193,10 +581,269 @@ class StampDB:
 
     def close(self):
         """Close the database connection."""
-        if not os.path.exists(self.schema_file):
+        if not self.read_only and not os.path.exists(self.schema_file):
             self.schema._save_schema_to_file()
         self._db.close()
 
+    def refresh(self) -> bool:
+        """Pick up the commits of the writing process in a read-only database.
+
+        Rows appended since the last refresh are parsed from the end of the
+        file; after a compaction the file is reloaded and subscriptions are
+        disconnected as lagged.
+
+        Returns:
+            bool: True if the database changed, always False when opened for writing.
+        """
+        return self._db.refresh()
+
+    def set_result_cache(self, max_bytes: int):
+        """Cache results of read_range and aggregate.
+
+        Repeated queries are answered from the cache. An entry is dropped as soon
+        as a point inside its time range is appended, updated or deleted, and the
+        least recently used entries are evicted to stay under `max_bytes`.
+
+        Args:
+            max_bytes: int
+                Memory cap of the cache, 0 disables it (default).
+        """
+        if max_bytes < 0:
+            raise ValueError("max_bytes must be non-negative.")
+        self._db.set_result_cache(max_bytes)
+
+    def cache_stats(self) -> dict:
+        """Result cache counters: hits, misses, evictions, invalidations, entries, bytes, capacity."""
+        stats = self._db.result_cache_stats()
+        return {
+            name: getattr(stats, name)
+            for name in ("hits", "misses", "evictions", "invalidations", "entries", "bytes", "capacity")
+        }
+
+    def set_hot_window(self, points: int, seconds: float = 0.0):
+        """Serve reads of recent data from an in-memory ring.
+
+        The ring holds the newest `points` points, and with `seconds` > 0 only
+        those within `seconds` of the newest one. read, read_range and aggregate
+        queries that start inside the window skip the index and the database
+        lock. Writes still go to the database file as usual; late points,
+        updates and deletes inside the window clear it until new points arrive.
+
+        Args:
+            points: int
+                Capacity of the ring, 0 disables it (default).
+            seconds: float
+                Time span of the window, 0 for no time limit.
+        """
+        if points < 0 or seconds < 0:
+            raise ValueError("points and seconds must be non-negative.")
+        self._db.set_hot_window(points, seconds)
+
+    def hot_window_stats(self) -> dict:
+        """Hot window counters: points, oldest_time, newest_time, hits, misses, retired."""
+        stats = self._db.hot_window_stats()
+        return {
+            name: getattr(stats, name)
+            for name in ("points", "oldest_time", "newest_time", "hits", "misses", "retired")
+        }
+
+    def set_durability(
+        self, mode: str = "ops", interval_ms: int = 100, pending_bytes: int = 1 << 20
+    ):
+        """Set when writes are committed to the database file.
+
+        Args:
+            mode: str
+                "ops" commits every `checkpoint_threshold` operations (default),
+                "none" commits only on checkpoint/close and never fsyncs,
+                "interval_ms" commits every `interval_ms` from a background thread,
+                "bytes" commits from a background thread once `pending_bytes` of rows are pending,
+                "every_op_fsync" commits and fsyncs every write before it returns.
+            interval_ms: int
+                Flush period for "interval_ms".
+            pending_bytes: int
+                Approximate size of pending rows that triggers a flush for "bytes".
+        """
+        modes = {
+            "ops": _backend.DurabilityMode.OPS,
+            "none": _backend.DurabilityMode.NONE,
+            "interval_ms": _backend.DurabilityMode.INTERVAL_MS,
+            "bytes": _backend.DurabilityMode.BYTES,
+            "every_op_fsync": _backend.DurabilityMode.EVERY_OP_FSYNC,
+        }
+        if mode not in modes:
+            raise ValueError(f"Unknown durability mode '{mode}', expected one of {list(modes)}.")
+
+        policy = _backend.DurabilityPolicy()
+        policy.mode = modes[mode]
+        policy.interval_ms = interval_ms
+        policy.bytes = pending_bytes
+        self._db.set_durability(policy)
+
+    def set_io_backend(
+        self,
+        backend: str = "posix",
+        direct_io: bool = False,
+        queue_depth: int = 4,
+        buffer_size: int = 1 << 20,
+    ):
+        """Set how checkpoints and compactions write the database file.
+
+        Args:
+            backend: str
+                "posix" for buffered write calls (default), "io_uring" for
+                asynchronous writes with `queue_depth` buffers in flight (Linux,
+                only if the extension was built with STAMPDB_WITH_IO_URING=1).
+            direct_io: bool
+                Keep large rewrites out of the page cache. io_uring uses O_DIRECT,
+                posix drops the written pages after they are synced.
+            queue_depth: int
+                Number of writes in flight for "io_uring".
+            buffer_size: int
+                Bytes per write.
+        """
+        backends = {
+            "posix": _backend.IOBackendKind.POSIX,
+            "io_uring": _backend.IOBackendKind.IO_URING,
+        }
+        if backend not in backends:
+            raise ValueError(f"Unknown I/O backend '{backend}', expected one of {list(backends)}.")
+        if backend == "io_uring" and not _backend.io_uring_available():
+            raise RuntimeError("StampDB was built without io_uring support.")
+
+        options = _backend.IOOptions()
+        options.backend = backends[backend]
+        options.direct_io = direct_io
+        options.queue_depth = queue_depth
+        options.buffer_size = buffer_size
+        self._db.IO = options
+
+    @property
+    def last_sequence(self) -> int:
+        """Sequence number of the last append, update or delete."""
+        return self._db.last_sequence()
+
+    @property
+    def committed_sequence(self) -> int:
+        """Sequence number up to which writes are on disk."""
+        return self._db.committed_sequence()
+
+    def wait_for_commit(self, sequence: int = None, timeout_ms: int = -1) -> bool:
+        """Block until a write is committed to disk.
+
+        Args:
+            sequence: Optional[int]
+                Sequence number to wait for, defaults to the last write.
+            timeout_ms: int
+                Maximum time to wait, negative waits forever.
+
+        Returns:
+            True if the write is committed, False on timeout.
+        """
+        if sequence is None:
+            sequence = self.last_sequence
+        return self._db.wait_for_commit(sequence, timeout_ms)
+
+    def subscribe(
+        self,
+        target=None,
+        from_seq: int = None,
+        capacity: int = 4096,
+        backpressure: str = "block",
+        block_timeout_ms: int = 1000,
+    ):
+        """Receive appended, updated and deleted points as they are written.
+
+        Every change after `from_seq` is delivered once, in sequence order, as
+        a ChangeEvent with `seq`, `kind` (ChangeKind.APPEND, UPDATE or DELETE),
+        `time` and `values`. Deletes carry the deleted values. Changes are
+        delivered when they are applied; compare `seq` with
+        `committed_sequence` to know whether they are on disk. In a read-only
+        database, the rows each `refresh` picks up are delivered as appends;
+        a `refresh` that reloads the file after a compaction cannot tell what
+        changed, it disconnects every subscription as lagged instead.
+
+        With a `target`, events are handed to it from a background thread:
+        a callable is called with each event, an object with a `put` method
+        (e.g. queue.Queue) has events put into it. Without a target, call
+        `poll` on the returned subscription.
+
+        Writers hand events over after releasing the database, so the target
+        and other threads can read while a writer waits for a "block"
+        subscriber. The target must not write to this database: its write
+        would wait for the delivery the target itself holds up, until
+        `block_timeout_ms` disconnects the subscription, or forever if it is
+        negative.
+
+        Args:
+            target: Optional[Callable or queue]
+                Receiver of the events.
+            from_seq: Optional[int]
+                Sequence number to start after, defaults to `last_sequence`.
+                Earlier starts need `set_change_retention`.
+            capacity: int
+                Events buffered for this subscriber.
+            backpressure: str
+                What a full buffer does to writers: "block" waits up to
+                `block_timeout_ms` for the subscriber (negative waits forever),
+                "disconnect" closes the subscription. A subscription closed for
+                falling behind has `lagged` set; resume from its `last_seq`.
+            block_timeout_ms: int
+                Longest wait of a writer for a "block" subscriber, negative
+                waits until the subscriber makes room or is closed.
+
+        Returns:
+            The subscription. `poll(max_events, timeout_ms)` returns the next
+            events, `close()` stops delivery.
+        """
+        policies = {
+            "block": _backend.Backpressure.BLOCK,
+            "disconnect": _backend.Backpressure.DISCONNECT,
+        }
+        if backpressure not in policies:
+            raise ValueError(f"Unknown backpressure '{backpressure}', expected one of {list(policies)}.")
+        if capacity <= 0:
+            raise ValueError("capacity must be positive.")
+        if target is not None:
+            deliver = getattr(target, "put", target)
+            if not callable(deliver):
+                raise ValueError("target must be callable or have a put method.")
+
+        if from_seq is None:
+            subscription = self._db.subscribe(
+                capacity=capacity, backpressure=policies[backpressure], block_timeout_ms=block_timeout_ms
+            )
+        else:
+            if from_seq < 0:
+                raise ValueError("from_seq must be non-negative.")
+            subscription = self._db.subscribe(from_seq, capacity, policies[backpressure], block_timeout_ms)
+
+        if target is not None:
+            def dispatch():
+                try:
+                    while True:
+                        events = subscription.poll(1024, -1)
+                        if not events:
+                            break
+                        for event in events:
+                            deliver(event)
+                finally:
+                    subscription.close()
+
+            threading.Thread(target=dispatch, name="stampdb-subscription", daemon=True).start()
+        return subscription
+
+    def set_change_retention(self, events: int):
+        """Keep the last `events` changes so subscriptions can start in the past.
+
+        Args:
+            events: int
+                Number of changes retained, 0 disables retention (default).
+        """
+        if events < 0:
+            raise ValueError("events must be non-negative.")
+        self._db.set_change_retention(events)
+
     @property
     def checkpoint_threshold(self) -> int:
         """Get the checkpoint threshold (number of operations before auto-compaction)."""
@@ -207,6 +854,26 @@ class StampDB:
         """Set the checkpoint threshold."""
         self._db.CHECKPOINT = value
 
+    @property
+    def threads(self) -> int:
+        """Get the number of threads used per query (0 means all hardware threads)."""
+        return self._db.THREADS
+
+    @threads.setter
+    def threads(self, value: int):
+        """Set the number of threads used per query (0 means all hardware threads)."""
+        self._db.THREADS = value
+
+    @property
+    def memtable_capacity(self) -> int:
+        """Get the number of out-of-order points buffered before merging into the index."""
+        return self._db.MEMTABLE_CAPACITY
+
+    @memtable_capacity.setter
+    def memtable_capacity(self, value: int):
+        """Set the number of out-of-order points buffered before merging into the index."""
+        self._db.MEMTABLE_CAPACITY = value
+
     def __enter__(self):
         """Context manager entry."""
         return self
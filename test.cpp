@@ -86,10 +86,10 @@ int main() {
         db.compact();
         cout << "Checkpoint completed.\n";
         
-        // Test 7: Test persistence by creating a new instance
+        // Test 7: Test persistence by opening a read-only instance next to the writer
         cout << "\n[Test 7] Testing persistence...\n";
         {
-            StampDB db2("test_db.csv");
+            StampDB db2("test_db.csv", {}, OpenMode::ReadOnly);
             cout << "Data after reloading from disk:\n";
             printCSVData(db2.read_range(0, 10));
         }
@@ -20,6 +20,12 @@ from stampdb.relational import (
 # Before running, make sure no "test.csv" file exists in the current directory.
 
 
+@pytest.fixture
+def db_file(tmp_path):
+    """Path of a fresh database file in a per-test directory, so no sidecar outlives its test."""
+    yield str(tmp_path / "test.csv")
+
+
 def test_db():
     db = StampDB("test.csv", schema={"temp": "float", "humidity": "string"})
     assert os.path.exists("test.csv") and os.path.getsize("test.csv") > 0
@@ -310,3 +316,716 @@ def test_get_timestamps():
             os.remove(test_file)
         if os.path.exists(test_file + ".schema"):
             os.remove(test_file + ".schema")
+
+
+def test_out_of_order_ingest(db_file):
+    """Late points are readable immediately and end up sorted on disk."""
+    db = StampDB(db_file, schema={"value": "float"})
+    db.checkpoint_threshold = 3
+
+    times = [5, 1, 9, 3, 7, 2, 8, 4, 6, 0]
+    for t in times:
+        db.append_point(Point(time=t, data=[t * 1.5]))
+
+    out = db.read_range(0, 100)
+    assert list(out["time"]) == sorted(times)
+
+    # Checkpoints merge the late points into the file
+    db.checkpoint()
+    with open(db_file) as f:
+        on_disk = [float(line.split(",")[0]) for line in f.readlines()[1:]]
+    assert on_disk == sorted(times)
+    assert db.committed_sequence == db.last_sequence
+
+    # So does every automatic checkpoint, updates included
+    db.update_point(Point(time=3, data=[30.0]))
+    db.append_point(Point(time=-1, data=[0.0]))
+    db.update_point(Point(time=5, data=[50.0]))
+    with open(db_file) as f:
+        rows = [line.split(",") for line in f.readlines()[1:]]
+    assert [float(row[0]) for row in rows] == sorted(times + [-1])
+    assert float(rows[4][1]) == 30.0
+
+    db.close()
+
+
+def test_rollups(db_file):
+    """Rollups follow appends, deletes and survive a reload."""
+    schema = {"value": "float"}
+    db = StampDB(db_file, schema=schema)
+    for t in range(30):
+        db.append_point(Point(time=t, data=[float(t)]))
+
+    assert db.add_rollup("per10", 10, ["value"]) is True
+    assert db.add_rollup("per10", 10, ["value"]) is False
+
+    out = db.read_rollup("per10", 0, 100)
+    assert out.size == 3
+    assert list(out["value_count"]) == [10, 10, 10]
+    assert out["value_sum"][1] == sum(range(10, 20))
+
+    db.delete_point(10)
+    db.append_point(Point(time=35, data=[100.0]))
+    out = db.read_rollup("per10", 10, 35)
+    assert out["value_min"][0] == 11
+    assert out["value_max"][-1] == 100
+    db.close()
+
+    db = StampDB(db_file, schema=schema)
+    out = db.read_rollup("per10", 0, 100)
+    assert list(out["value_count"]) == [10, 9, 10, 1]
+    db.close()
+
+
+def test_rollup_min_max_after_compaction(db_file):
+    """Deleting a bucket's min or max is reflected after compaction and a reopen."""
+    schema = {"value": "float"}
+    db = StampDB(db_file, schema=schema)
+    for t in range(30):
+        db.append_point(Point(time=t, data=[float(t)]))
+    db.add_rollup("per10", 10, ["value"])
+    db.delete_point(19)
+    db.delete_point(20)
+    db.compact()
+    db.close()
+
+    db = StampDB(db_file, schema=schema)
+    out = db.read_rollup("per10", 0, 100)
+    assert list(out["value_max"]) == [9, 18, 29]
+    assert list(out["value_min"]) == [0, 10, 21]
+    db.close()
+
+
+def test_parallel_scan_and_aggregate(db_file):
+    """Multi-threaded scans and aggregates match the single-threaded result."""
+    db = StampDB(db_file, schema={"value": "float"})
+    db.checkpoint_threshold = 1000
+    n = 20000
+    for t in range(n):
+        db.append_point(Point(time=t, data=[float(t)]))
+
+    single = db.read_range(0, n, threads=1)
+    db.threads = 4
+    multi = db.read_range(0, n)
+    assert np.array_equal(single["time"], multi["time"])
+    assert np.array_equal(single["value"], multi["value"])
+    every_core = db.read_range(0, n, threads=0)
+    assert np.array_equal(single["value"], every_core["value"])
+
+    agg = db.aggregate("value", 100, 199, threads=4)
+    assert agg["count"] == 100
+    assert agg["sum"] == sum(range(100, 200))
+    assert agg["min"] == 100 and agg["max"] == 199
+
+    db.close()
+
+
+def test_append_arrays(db_file):
+    """Bulk import from NumPy arrays matches point-by-point ingest."""
+    schema = {"temp": "float", "count": "int", "ok": "bool", "label": "string"}
+    db = StampDB(db_file, schema=schema)
+
+    n = 1000
+    times = np.arange(n, dtype=np.float64)[::-1]
+    appended = db.append_arrays(
+        times,
+        temp=times * 0.5,
+        count=np.arange(n, dtype=np.int64),
+        ok=np.arange(n) % 2 == 0,
+        label=np.array(["a", "b"] * (n // 2)),
+    )
+    assert appended == n
+
+    out = db.read_range(0, n)
+    assert out.size == n
+    assert np.array_equal(out["time"], np.arange(n))
+    assert np.array_equal(out["temp"], np.arange(n) * 0.5)
+    assert out["label"][n - 1] == "a"
+
+    # Existing times are skipped, wrong dtypes are rejected before reaching C++.
+    assert db.append_arrays(
+        [0.0, float(n)],
+        temp=[1.0, 2.0],
+        count=[1, 2],
+        ok=[True, False],
+        label=["x", "y"],
+    ) == 1
+    with pytest.raises(ValueError):
+        db.append_arrays([n + 1.0], temp=["hot"], count=[1], ok=[True], label=["x"])
+
+    db.close()
+
+
+def test_schema_typed_columns(db_file):
+    """Columns keep their schema types across writes and reloads."""
+    schema = {"temp": "float", "count": "int", "ok": "bool", "label": "string"}
+    db = StampDB(db_file, schema=schema)
+    db.append_point(Point(time=1, data=[20, 3, True, "a"]))
+    db.append_point(Point(time=2, data=[21.5, 4, False, "12"]))
+    # Int columns reject fractions, NaN and values out of range
+    for count in (1.5, float("nan"), 1e12):
+        with pytest.raises(ValueError):
+            db.append_point(Point(time=3, data=[22, count, True, "b"]))
+    db.close()
+
+    db = StampDB(db_file, schema=schema)
+    out = db.read_range(0, 10)
+    assert out.dtype["temp"] == np.float64
+    assert out.dtype["count"] == np.int32
+    assert out.dtype["ok"] == np.bool_
+    assert list(out["temp"]) == [20.0, 21.5]
+    assert list(out["count"]) == [3, 4]
+    assert list(out["label"]) == ["a", "12"]
+
+    db.close()
+
+
+def test_sparse_index_sidecar(db_file):
+    """Open uses the persisted index and falls back when it is stale."""
+    db = StampDB(db_file, schema={"value": "float"})
+    n = 10000
+    times = np.arange(n, dtype=np.float64)
+    db.append_arrays(times, value=times * 2.0)
+    db.close()
+    assert os.path.exists(db_file + ".idx")
+
+    db = StampDB(db_file, schema={"value": "float"})
+    out = db.read_range(0, n)
+    assert out.size == n
+    assert np.array_equal(out["value"], times * 2.0)
+    db.close()
+
+    # A row written behind the database's back invalidates the sidecar.
+    with open(db_file, "a") as f:
+        f.write(f"{n}.000000,1.5\n")
+
+    db = StampDB(db_file, schema={"value": "float"})
+    assert db.read(n)["value"][0] == 1.5
+    assert db.read_range(0, n + 1).size == n + 1
+    db.close()
+
+    # A stale index must not cut the last row of a file rewritten by hand
+    with open(db_file, "w") as f:
+        f.write("time,value\n")
+        f.writelines(f"{t}.000000,{t}.25\n" for t in range(n + 5))
+        f.write(f"{n + 5}.000000,7.5")
+
+    db = StampDB(db_file, schema={"value": "float"})
+    assert db.read(n + 5)["value"][0] == 7.5
+    db.close()
+
+
+def test_durability_policy(db_file):
+    """Background commits are observable through sequence numbers."""
+    db = StampDB(db_file, schema={"value": "float"})
+    db.set_durability("interval_ms", interval_ms=10)
+    for t in range(50):
+        db.append_point(Point(time=t, data=[t * 1.0]))
+
+    assert db.last_sequence == 50
+    assert db.wait_for_commit(timeout_ms=5000)
+    assert db.committed_sequence == 50
+    with open(db_file) as f:
+        assert len(f.readlines()) == 51
+
+    db.set_durability("every_op_fsync")
+    db.append_point(Point(time=100, data=[1.0]))
+    assert db.committed_sequence == db.last_sequence
+
+    with pytest.raises(ValueError):
+        db.set_durability("sometimes")
+
+    db.close()
+
+
+def test_io_backend(db_file):
+    """Rewrites through the configured I/O backend round-trip."""
+    from stampdb import _backend
+
+    backends = ["posix"] + (["io_uring"] if _backend.io_uring_available() else [])
+    db = StampDB(db_file, schema={"value": "float", "label": "string"})
+    for i, backend in enumerate(backends):
+        db.set_io_backend(backend, direct_io=True, buffer_size=4096)
+        # Late points force a full, time-ordered rewrite.
+        for t in range(500, 0, -1):
+            db.append_point(Point(time=t + i * 1000, data=[t * 0.5, f"row{t}"]))
+        db.compact()
+    db.close()
+
+    db = StampDB(db_file, schema={"value": "float", "label": "string"})
+    out = db.read_range(0, 1e9)
+    assert out.size == 500 * len(backends)
+    assert out["label"][0] == "row1"
+    assert out["value"][499] == 250.0
+    db.close()
+
+    with pytest.raises(ValueError):
+        db.set_io_backend("mmap")
+
+
+def test_result_cache(db_file):
+    """Repeated queries hit the cache until a write touches their range."""
+    db = StampDB(db_file, schema={"value": "float"})
+    for t in range(0, 100, 2):
+        db.append_point(Point(time=t, data=[t * 1.0]))
+    db.set_result_cache(1 << 20)
+
+    first = db.read_range(10, 20)
+    second = db.read_range(10, 20)
+    assert np.array_equal(first, second)
+    assert db.aggregate("value", 10, 20) == db.aggregate("value", 10, 20)
+    stats = db.cache_stats()
+    assert stats["hits"] == 2 and stats["misses"] == 2
+
+    # Outside the cached range: entries survive.
+    db.append_point(Point(time=51, data=[1.0]))
+    assert db.cache_stats()["entries"] == 2
+
+    # Inside: both entries are dropped and the next read sees the new point.
+    db.append_point(Point(time=15, data=[1.0]))
+    assert db.cache_stats()["entries"] == 0
+    assert db.read_range(10, 20).size == first.size + 1
+
+    db.delete_point(12)
+    assert db.read_range(10, 20).size == first.size
+
+    # NaN bounds have no order and bypass the cache
+    entries = db.cache_stats()["entries"]
+    assert db.read_range(float("nan"), 20).size == 0
+    db.aggregate("value", 10, float("nan"))
+    assert db.cache_stats()["entries"] == entries
+
+    db.close()
+
+
+def test_column_projection(db_file):
+    """read and read_range return only the requested columns."""
+    db = StampDB(db_file, schema={"a": "float", "b": "int", "c": "string"})
+    for t in range(10):
+        db.append_point(Point(time=t, data=[t * 0.5, t, f"s{t}"]))
+
+    rows = db.read_range(2, 5, columns=["c", "a"])
+    assert rows.dtype.names == ("time", "c", "a")
+    assert list(rows["c"]) == ["s2", "s3", "s4", "s5"]
+    assert np.allclose(rows["a"], [1.0, 1.5, 2.0, 2.5])
+
+    row = db.read(3, columns=["b"])
+    assert row.dtype.names == ("time", "b")
+    assert row["b"][0] == 3
+
+    # No columns reads everything
+    assert db.read_range(2, 5).dtype.names == ("time", "a", "b", "c")
+
+    with pytest.raises(ValueError):
+        db.read_range(2, 5, columns=["missing"])
+
+    db.close()
+
+
+def _crash_workload(test_file, seed, fault):
+    """Random appends, late points, updates, deletes and commits until the workload ends or crashes.
+
+    `fault` is (operation, kind, torn_fraction), counted from the first write.
+    Returns the write log as (sequence, time, value or None for a deletion),
+    plus the last and committed sequence numbers at the moment of the crash.
+    """
+    from stampdb import _backend
+
+    rng = random.Random(seed)
+    db = StampDB(test_file, schema={"value": "float"})
+    db.set_durability(rng.choice(["ops", "every_op_fsync", "none"]))
+    db.checkpoint_threshold = rng.randint(1, 6)
+    if rng.random() < 0.5:
+        db.set_io_backend("posix", buffer_size=16)  # Many small writes to tear
+    _backend.arm_faults(*fault)
+
+    log, live = [], {}
+    try:
+        for i in range(60):
+            action = rng.random()
+            t = float(rng.randrange(40))
+            value = float(i * 1000 + rng.randrange(1000))
+            sequence = db.last_sequence
+            try:
+                if action < 0.5:
+                    if t in live:
+                        continue
+                    live[t] = value
+                    log.append((sequence + 1, t, value))
+                    db.append_point(Point(time=t, data=[value]))
+                elif action < 0.8:
+                    if t not in live:
+                        continue
+                    if action < 0.7:
+                        del live[t]
+                        log.append((sequence + 1, t, None))
+                        db.delete_point(t)
+                    else:
+                        live[t] = value
+                        log.append((sequence + 1, t, None))
+                        log.append((sequence + 2, t, value))
+                        db.update_point(Point(time=t, data=[value]))
+                elif action < 0.9:
+                    db.checkpoint()
+                else:
+                    db.compact()
+            except RuntimeError:
+                pass  # Injected I/O error, the write stays pending
+    except _backend.SimulatedCrash:
+        pass
+
+    last, committed = db.last_sequence, db.committed_sequence
+    del db  # Dropped without close, like a killed process
+    return log, last, committed
+
+
+def test_crash_recovery_with_fault_injection(db_file):
+    """No acknowledged write is lost and no acknowledged deletion comes back after a fault."""
+    from stampdb import _backend
+
+    test_file = db_file
+    kinds = [_backend.FaultKind.FAIL, _backend.FaultKind.TORN, _backend.FaultKind.CRASH]
+
+    def reset():
+        for suffix in ("", ".schema", ".idx", ".idx.tmp", ".tmp", ".rollups"):
+            if os.path.exists(test_file + suffix):
+                os.remove(test_file + suffix)
+
+    try:
+        for seed in range(40):
+            rng = random.Random(seed + 1000)
+
+            # Dry run to count the I/O operations of this workload
+            reset()
+            _crash_workload(test_file, seed, (0, _backend.FaultKind.CRASH, 0.5))
+            operations = _backend.fault_operation_count()
+            _backend.disarm_faults()
+
+            # Same workload, faulting one of those operations
+            reset()
+            fault = (rng.randint(1, operations), rng.choice(kinds), rng.random())
+            log, last, committed = _crash_workload(test_file, seed, fault)
+            assert _backend.fault_triggered()
+            _backend.disarm_faults()
+
+            # State acknowledged by the last commit, and what later writes may have left behind
+            acked, later = {}, {}
+            for sequence, t, value in log:
+                if sequence > last:
+                    continue  # Never applied
+                if sequence <= committed:
+                    acked[t] = value
+                else:
+                    later.setdefault(t, set()).add(value)
+
+            db = StampDB(test_file, schema={"value": "float"})
+            rows = db.read_range(-1, 1e9)
+            recovered = {} if rows.size == 0 else dict(zip(rows["time"], rows["value"]))
+            assert rows.size == len(recovered), f"seed {seed}: duplicate rows"
+            for t in set(acked) | set(recovered):
+                value = recovered.get(t)
+                assert value == acked.get(t) or value in later.get(t, ()), (
+                    f"seed {seed} {fault}: time {t} recovered as {value}, acknowledged {acked.get(t)}"
+                )
+            db.close()
+    finally:
+        _backend.disarm_faults()
+
+
+def test_hot_window(db_file):
+    """Recent reads are served from the hot window and match the main store."""
+    db = StampDB(db_file, schema={"value": "float"})
+    for t in range(100):
+        db.append_point(Point(time=t, data=[t * 1.0]))
+    db.set_hot_window(20)
+    stats = db.hot_window_stats()
+    assert stats["points"] == 20 and stats["oldest_time"] == 80 and stats["newest_time"] == 99
+
+    db.append_point(Point(time=100, data=[100.0]))
+    rows = db.read_range(90, 200)
+    assert list(rows["time"]) == list(range(90, 101))
+    assert db.aggregate("value", 95, 100)["sum"] == sum(range(95, 101))
+    assert db.read(100)["value"][0] == 100.0
+    assert db.hot_window_stats()["hits"] == 3
+
+    # Older ranges fall back to the main store
+    assert db.read_range(10, 95).size == 86
+    assert db.hot_window_stats()["misses"] == 1
+
+    # Deleting inside the window clears it, reads stay correct
+    db.delete_point(95)
+    assert db.hot_window_stats()["points"] == 0
+    assert 95 not in db.read_range(90, 200)["time"]
+    db.append_point(Point(time=101, data=[101.0]))
+    assert db.read_range(101, 101)["value"][0] == 101.0
+
+    db.close()
+
+
+def test_hot_window_concurrent_readers(db_file):
+    """Replaced entries are freed while reader threads keep hitting the window."""
+    import threading
+
+    db = StampDB(db_file, schema={"value": "float"})
+    db.set_hot_window(64)
+    db.append_point(Point(time=0, data=[0.0]))
+    stop = threading.Event()
+    errors = []
+
+    def reader():
+        while not stop.is_set():
+            newest = db.hot_window_stats()["newest_time"]
+            rows = db.read_range(newest - 20, newest)
+            if list(rows["time"]) != sorted(rows["time"]):
+                errors.append(rows)
+
+    readers = [threading.Thread(target=reader) for _ in range(4)]
+    for thread in readers:
+        thread.start()
+    retired = 0
+    for start in range(1, 20001, 100):
+        times = np.arange(start, start + 100, dtype=np.float64)
+        db.append_arrays(times, value=times)
+        retired = max(retired, db.hot_window_stats()["retired"])
+    stop.set()
+    for thread in readers:
+        thread.join()
+
+    assert not errors
+    assert db.hot_window_stats()["hits"] > 0
+    # 20000 entries were replaced, only a few batches may wait for readers
+    assert retired < 1000
+    db.close()
+
+
+def test_approximate_queries(db_file):
+    """Sketch-based quantiles and distinct counts track the exact answers and survive a reopen."""
+    n = 50000
+    times = np.arange(n, dtype=np.float64)
+    values = np.random.default_rng(7).lognormal(size=n)
+    db = StampDB(db_file, schema={"value": "float", "kind": "int"})
+    db.append_arrays(times, value=values, kind=(np.arange(n) % 40).astype(np.int32))
+    db.checkpoint()
+    assert db.enable_sketches()
+    assert not db.enable_sketches()
+
+    qs = [0.1, 0.5, 0.99]
+    estimates = db.approx_quantile("value", 1000, 40000, qs)
+    window = np.sort(values[1000:40001])
+    for q, estimate in zip(qs, estimates):
+        rank = np.searchsorted(window, estimate) / window.size
+        assert abs(rank - q) < 0.01
+    assert abs(db.approx_distinct("kind", 0, n) - 40) <= 1
+    assert abs(db.approx_distinct("value", 0, n) - n) < 0.05 * n
+    assert np.isnan(db.approx_quantile("value", -10, -1))
+
+    # Deleted rows drop out before and after compaction, and after a reopen
+    for t in range(0, 1000, 10):
+        db.delete_point(t)
+    assert abs(db.approx_distinct("value", 0, 999) - 900) < 45
+    db.compact()
+    db.close()
+
+    db = StampDB(db_file, schema={"value": "float", "kind": "int"})
+    assert abs(db.approx_distinct("value", 0, 999) - 900) < 45
+    kept = values[(np.arange(n) % 10 != 0) | (np.arange(n) >= 1000)]
+    assert abs(db.approx_quantile("value", 0, n, 0.5) - np.median(kept)) < 0.05
+    assert db.drop_sketches()
+    db.close()
+
+
+def test_resample(db_file):
+    """Resampling fills a regular grid with linear, previous-value and null fill."""
+    db = StampDB(db_file, schema={"value": "float", "count": "int", "label": "string"})
+    for t, value in ((0.0, 0.0), (1.0, 10.0), (4.0, 40.0)):
+        db.append_point(Point(time=t, data=[value, int(value), "x"]))
+
+    grid = db.resample(0, 5, 0.5)
+    assert grid.dtype.names == ("time", "value", "count")
+    assert list(grid["time"]) == [0.0, 0.5, 1.0, 1.5, 2.0, 2.5, 3.0, 3.5, 4.0, 4.5, 5.0]
+    assert list(grid["value"][:9]) == [0.0, 5.0, 10.0, 15.0, 20.0, 25.0, 30.0, 35.0, 40.0]
+    assert np.isnan(grid["value"][9:]).all()
+
+    previous = db.resample(-1, 5, 1, method="previous", columns=["value"])
+    assert previous.dtype.names == ("time", "value")
+    assert np.isnan(previous["value"][0])
+    assert list(previous["value"][1:]) == [0.0, 10.0, 10.0, 10.0, 40.0, 40.0]
+
+    null = db.resample(0, 5, 1, method="null", columns=["value"])
+    assert list(np.isnan(null["value"])) == [False, False, True, True, False, True]
+
+    with pytest.raises(ValueError):
+        db.resample(0, 5, 1, method="cubic")
+    with pytest.raises(ValueError):
+        db.resample(0, 5, 1, columns=["label"])
+
+    db.close()
+
+
+def test_shared_read_access(db_file):
+    """A read-only open follows the writer's commits, a second writer is refused."""
+    schema = {"value": "float"}
+    writer = StampDB(db_file, schema=schema)
+    times = np.arange(100, dtype=np.float64)
+    writer.append_arrays(times, value=times * 2.0)
+    writer.checkpoint()
+
+    reader = StampDB(db_file, schema=schema, read_only=True)
+    assert reader.read_range(0, 1000).size == 100
+    assert not reader.refresh()
+    with pytest.raises(RuntimeError):
+        StampDB(db_file, schema=schema)
+    with pytest.raises(RuntimeError):
+        reader.append_point(Point(time=1000, data=[1.0]))
+
+    # Appended rows are parsed from the end of the file
+    times = np.arange(100, 150, dtype=np.float64)
+    writer.append_arrays(times, value=times * 2.0)
+    writer.checkpoint()
+    assert reader.refresh()
+    assert reader.read_range(0, 1000).size == 150
+    assert reader.read(149)["value"][0] == 298.0
+
+    # A compaction replaces the file, the reader reloads it
+    writer.delete_point(0)
+    writer.compact()
+    assert reader.refresh()
+    out = reader.read_range(-1, 1000)
+    assert out.size == 149
+    assert out["time"][0] == 1.0
+
+    # A failed index write keeps the last published one, readers catch up
+    # with the next commit
+    os.mkdir(db_file + ".idx.tmp")
+    writer.append_point(Point(time=200, data=[1.0]))
+    writer.checkpoint()
+    assert os.path.exists(db_file + ".idx")
+    assert not reader.refresh()
+    os.rmdir(db_file + ".idx.tmp")
+    writer.append_point(Point(time=201, data=[1.0]))
+    writer.checkpoint()
+    assert reader.refresh()
+    assert reader.read_range(-1, 1000).size == 151
+
+    # Without an index matching the data file a reader refuses to open
+    # rather than parse rows the writer has not committed
+    with open(db_file + ".idx", "w") as f:
+        f.write("stampdb-index,1\n")
+    with pytest.raises(RuntimeError):
+        StampDB(db_file, schema=schema, read_only=True)
+
+    reader.close()
+    writer.close()
+    assert not os.path.exists(db_file + ".lock")
+
+    db = StampDB(db_file, schema=schema)
+    db.close()
+
+
+def test_arrow_export_import(db_file, tmp_path):
+    """Ranges export as Arrow record batches and import back without loss."""
+    source_file, target_file = db_file, str(tmp_path / "target.csv")
+    schema = {"value": "float", "count": "int", "ok": "bool", "label": "string"}
+    db = StampDB(source_file, schema=schema)
+    label = "a label longer than the fixed width NumPy strings " * 8
+    for t in range(10):
+        db.append_point(Point(time=t, data=[t * 0.5, t, t % 2 == 0, f"{label}{t}"]))
+
+    batch = db.read_range_arrow(2, 7)
+    assert len(batch) == 6
+    assert hasattr(batch, "__arrow_c_array__") and hasattr(batch, "__arrow_c_stream__")
+    assert len(db.read_range_arrow(2, 7, columns=["label"])) == 6
+
+    try:
+        import pyarrow as pa
+    except ImportError:
+        pa = None
+    if pa is not None:
+        table = pa.record_batch(batch)
+        assert table.schema.names == ["time", "value", "count", "ok", "label"]
+        assert table.column("count").type == pa.int32()
+        assert table.column("label")[0].as_py() == f"{label}2"
+
+    other = StampDB(target_file, schema=schema)
+    assert other.append_arrow(batch) == 6
+    out = other.read_range(0, 10)
+    assert list(out["time"]) == [2.0, 3.0, 4.0, 5.0, 6.0, 7.0]
+    assert list(out["count"]) == [2, 3, 4, 5, 6, 7]
+    assert list(out["ok"]) == [True, False, True, False, True, False]
+    assert other.read_range_arrow(0, 10).num_rows == 6
+
+    with pytest.raises(ValueError):
+        other.append_arrow(db.read_range_arrow(0, 10, columns=["value"]))
+    with pytest.raises(ValueError):
+        other.append_arrow([1, 2, 3])
+
+    db.close()
+    other.close()
+
+
+def test_change_feed(db_file):
+    """Subscribers get appends, updates and deletes in sequence order."""
+    import queue
+    from stampdb._backend import ChangeKind
+
+
+    db = StampDB(db_file, schema={"value": "float"})
+    db.append_point(Point(time=0, data=[0.0]))
+
+    subscription = db.subscribe()
+    received = queue.Queue()
+    db.subscribe(received)
+
+    db.append_point(Point(time=1, data=[1.0]))
+    db.update_point(Point(time=1, data=[5.0]))
+    db.delete_point(0)
+    times = np.arange(10, 20, dtype=np.float64)
+    db.append_arrays(times, value=times)
+
+    events = subscription.poll(100, 0)
+    assert [event.kind for event in events[:3]] == [ChangeKind.APPEND, ChangeKind.UPDATE, ChangeKind.DELETE]
+    assert events[1].values == [5.0]
+    assert events[2].time == 0
+    assert len(events) == 13
+    assert [event.seq for event in events] == sorted(event.seq for event in events)
+    assert events[-1].seq == db.last_sequence == subscription.last_seq
+
+    # The background thread hands the same events to the queue
+    delivered = [received.get(timeout=5) for _ in range(13)]
+    assert [event.seq for event in delivered] == [event.seq for event in events]
+
+    # Starting in the past needs retained events
+    with pytest.raises(ValueError):
+        db.subscribe(from_seq=1)
+    db.set_change_retention(100)
+    start = db.last_sequence
+    db.append_point(Point(time=30, data=[3.0]))
+    db.append_point(Point(time=31, data=[3.1]))
+    replay = db.subscribe(from_seq=start).poll(100, 0)
+    assert [event.time for event in replay] == [30, 31]
+
+    # A target may read the database while writers wait for it
+    reads = queue.Queue()
+    db.subscribe(lambda event: reads.put(db.read(event.time).size), capacity=2, block_timeout_ms=-1)
+    for t in range(50, 80):
+        db.append_point(Point(time=t, data=[float(t)]))
+    assert [reads.get(timeout=5) for _ in range(30)] == [1] * 30
+
+    # A subscriber that falls behind is disconnected
+    small = db.subscribe(capacity=2, backpressure="disconnect")
+    for t in range(40, 45):
+        db.append_point(Point(time=t, data=[float(t)]))
+    assert small.lagged
+
+    # A reader that reloads the file cannot tell what changed
+    db.checkpoint()
+    reader = StampDB(db_file, schema={"value": "float"}, read_only=True)
+    follower = reader.subscribe()
+    db.delete_point(50)
+    db.compact()
+    assert reader.refresh()
+    assert follower.lagged and follower.closed
+    reader.close()
+
+    db.close()
+    assert subscription.closed